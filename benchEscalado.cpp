@@ -0,0 +1,275 @@
+//============================================================================
+// Introducción a los Modelos Computacionales
+// Name        : MLP-Classification (prueba de escalabilidad del entrenamiento)
+// Author      : Carlos Gómez Pino
+// Version     : 2016
+// Copyright   : Universidad de Córdoba
+//============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Inclusión de la clase PerceptrónMulticapa, del comunicador y del generador de datos sintéticos
+#include "perceptronMulticapa.hpp"
+#include "comunicador.hpp"
+#include "datosSinteticos.hpp"
+
+// Tasa de aprendizaje (la de mlpClassification.x por defecto)
+#define TASA_APRENDIZAJE 0.1
+
+// Configuración de una de las ejecuciones del barrido
+struct Configuracion {
+	int nPatrones;  /* Nº de patrones de entrenamiento */
+	int nCapas;     /* Nº de capas ocultas */
+	int nNeuronas;  /* Nº de neuronas por capa oculta */
+	int nProcesos;  /* Nº de procesos del entrenamiento distribuido */
+};
+
+// Leer una lista de enteros positivos separados por comas (vacía si algún valor no es válido)
+static std::vector<int> leerLista(const char * texto) {
+
+	std::vector<int> valores;
+	char * fin;
+	do {
+		long valor = strtol(texto, &fin, 10);
+		if (fin == texto or valor < 1)
+			return std::vector<int>();
+		valores.push_back(valor);
+		texto = fin + 1;
+	} while (*fin == ',');
+
+	if (*fin != '\0')
+		return std::vector<int>();
+	return valores;
+}
+
+// Entrenar la configuración indicada en el proceso actual y devolver el tiempo medio por época (segundos)
+// Se genera el conjunto de datos, se crean los procesos trabajadores, se entrena una época de
+// calentamiento y se mide el tiempo real de las épocas siguientes
+// Si se indica un fichero, el conjunto se escribe en él y se lee con leerDatos (como en mlpClassification.x),
+// se devuelve en lectura el tiempo de esa lectura y el fichero se borra después
+static double medirEpoca(const Configuracion &configuracion, const int &nEntradas, const int &nClases, const double &dispersion, const int &nEpocas, const bool &bOnline, const char * fichero, double &lectura) {
+
+	imc::GeneradorDatos generador(nEntradas, nClases, dispersion, 0.5, 1, 0);
+	imc::PerceptronMulticapa mlp;
+	imc::Datos * pDatos;
+	lectura = 0.0;
+	if (fichero != NULL) {
+		if (generador.guardarDatos(fichero, configuracion.nPatrones) == EXIT_FAILURE)
+			exit(-1);
+		std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+		pDatos = mlp.leerDatos(fichero);
+		lectura = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+		unlink(fichero);
+		if (pDatos == NULL)
+			exit(-1);
+	}else
+		pDatos = generador.generarDatos(configuracion.nPatrones);
+
+	std::vector<int> vTopologia(configuracion.nCapas+2, configuracion.nNeuronas);
+	vTopologia[0] = nEntradas;
+	vTopologia[configuracion.nCapas+1] = nClases;
+
+	// La tasa de aprendizaje se escala como en mlpClassification.x: en la versión off-line los cambios
+	// de todos los patrones (de todos los procesos) se suman antes de ajustar los pesos
+	mlp.setSesgo(true);
+	mlp.setEta((bOnline) ? TASA_APRENDIZAJE : TASA_APRENDIZAJE / configuracion.nPatrones);
+	mlp.setMu(0.9);
+	mlp.setOnline(bOnline);
+	mlp.setSemilla(1);
+	if (mlp.inicializar(vTopologia.size(),vTopologia,true) == EXIT_FAILURE)
+		exit(-1);
+	mlp.pesosAleatorios();
+
+	// Cada proceso entrena con su parte de los patrones, como en ejecutarAlgoritmo
+	imc::ComunicadorMemoriaCompartida comunicador;
+	int rango = 0;
+	if (configuracion.nProcesos > 1) {
+		if (comunicador.inicializar(configuracion.nProcesos) == EXIT_FAILURE)
+			exit(-1);
+		rango = comunicador.lanzarProcesos();
+		mlp.setComunicador(&comunicador);
+	}
+
+	imc::Vista vistaLocal = imc::crearVista(pDatos);
+	if (configuracion.nProcesos > 1) {
+		vistaLocal.indices.clear();
+		for(int i=rango; i<pDatos->nNumPatrones; i+=configuracion.nProcesos)
+			vistaLocal.indices.push_back(i);
+	}
+
+	mlp.entrenar(vistaLocal,1);
+
+	std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+	for(int e=0; e<nEpocas; e++)
+		mlp.entrenar(vistaLocal,1);
+	double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+
+	// Los procesos trabajadores terminan aquí; el principal espera por ellos
+	if (rango > 0)
+		exit(EXIT_SUCCESS);
+	comunicador.esperarProcesos();
+
+	return segundos / nEpocas;
+}
+
+int main(int argc, char **argv) {
+
+    /* Valores de entrada del programa */
+
+    // Listas de valores del barrido: patrones, capas ocultas, neuronas por capa y procesos
+    std::vector<int> vPatrones = {10000, 100000};
+    std::vector<int> vCapas = {1};
+    std::vector<int> vNeuronas = {16, 128};
+    std::vector<int> vProcesos = {1, 2, 4};
+
+    // Nº de entradas, nº de clases y proporción de entradas que valen 0 del problema sintético
+    int nvalue = 64;
+    int cvalue = 10;
+    double dvalue = 0.0;
+
+    // Nº de épocas que se miden en cada configuración
+    int evalue = 3;
+
+    // Indica si se utiliza la versión on-line (solo con un proceso)
+    bool oflag = false;
+
+    // Fichero temporal por el que pasan los datos (NULL => se generan directamente en memoria)
+    char * fvalue = NULL;
+
+    int c;
+    bool bCorrecto = true;
+    while ((c = getopt (argc, argv, "p:l:h:w:n:c:d:e:of:")) != -1) {
+    	switch(c) {
+    	case 'p':
+    		vPatrones = leerLista(optarg);
+    		break;
+    	case 'l':
+    		vCapas = leerLista(optarg);
+    		break;
+    	case 'h':
+    		vNeuronas = leerLista(optarg);
+    		break;
+    	case 'w':
+    		vProcesos = leerLista(optarg);
+    		break;
+    	case 'n':
+    		nvalue = atoi(optarg);
+    		break;
+    	case 'c':
+    		cvalue = atoi(optarg);
+    		break;
+    	case 'd':
+    		dvalue = atof(optarg);
+    		break;
+    	case 'e':
+    		evalue = atoi(optarg);
+    		break;
+    	case 'o':
+    		oflag = true;
+    		break;
+    	case 'f':
+    		fvalue = optarg;
+    		break;
+    	default:
+    		bCorrecto = false;
+    	}
+    }
+
+    if (oflag)
+    	vProcesos = {1};
+
+    if (!bCorrecto or vPatrones.empty() or vCapas.empty() or vNeuronas.empty() or vProcesos.empty()
+    		or nvalue < 1 or cvalue < 2 or dvalue < 0.0 or dvalue >= 1.0 or evalue < 1) {
+    	fprintf (stderr, "\n # Uso: %s [-p patrones,...] [-l capas,...] [-h neuronas,...] [-w procesos,...] [-n entradas] [-c clases] [-d dispersión] [-e épocas] [-o] [-f fichero]\n", argv[0]);
+    	exit(-1);
+    }
+
+    // La eficiencia paralela se calcula respecto al menor nº de procesos del barrido
+    std::sort(vProcesos.begin(), vProcesos.end());
+
+    std::cout << "\n*************************" << std::endl;
+    std::cout << " Prueba de escalabilidad" << std::endl;
+    std::cout << "*************************" << std::endl;
+    std::cout << " > Problema.......................: " << nvalue << " entradas, " << cvalue << " clases, " << 100.0 * dvalue << "% de entradas nulas" << std::endl;
+    std::cout << " > Versión........................: " << ((oflag)?"On-line":"Off-line") << ", " << evalue << " épocas medidas tras una de calentamiento" << std::endl;
+    std::cout << " > Datos..........................: " << ((fvalue != NULL) ? "Escritos y leídos con leerDatos a través de " + std::string(fvalue) : std::string("Generados en memoria")) << std::endl;
+    std::cout << " > Núcleos disponibles............: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << std::endl;
+    printf("%10s %6s %9s %9s %12s %13s %14s %20s %11s\n", "Patrones", "Capas", "Neuronas", "Procesos", "Lectura (s)", "Época (s)", "Patrones/s", "RSS máx. proc. (MB)", "Eficiencia");
+    fflush(stdout);
+
+    // Cada configuración se ejecuta en un proceso nuevo para que el pico de memoria sea solo el suyo
+    for(size_t ip=0; ip<vPatrones.size(); ip++) {
+    	for(size_t il=0; il<vCapas.size(); il++) {
+    		for(size_t ih=0; ih<vNeuronas.size(); ih++) {
+    			double tiempoBase = 0.0;
+    			for(size_t iw=0; iw<vProcesos.size(); iw++) {
+    				Configuracion configuracion = {vPatrones[ip], vCapas[il], vNeuronas[ih], std::min(vProcesos[iw], vPatrones[ip])};
+
+    				int tuberia[2];
+    				if (pipe(tuberia) == -1) {
+    					perror("pipe");
+    					exit(-1);
+    				}
+
+    				pid_t pid = fork();
+    				if (pid == -1) {
+    					perror("fork");
+    					exit(-1);
+    				}
+    				if (pid == 0) {
+    					close(tuberia[0]);
+    					double tiempos[2];
+    					tiempos[1] = medirEpoca(configuracion, nvalue, cvalue, dvalue, evalue, oflag, fvalue, tiempos[0]);
+    					_exit((write(tuberia[1], tiempos, sizeof(tiempos)) == sizeof(tiempos)) ? EXIT_SUCCESS : EXIT_FAILURE);
+    				}
+    				close(tuberia[1]);
+
+    				// Tiempo de lectura de los datos y tiempo medio por época
+    				double tiempos[2] = {0.0, 0.0};
+    				bool bLeido = (read(tuberia[0], tiempos, sizeof(tiempos)) == sizeof(tiempos));
+    				close(tuberia[0]);
+    				double tiempo = tiempos[1];
+
+    				// ru_maxrss no suma los procesos de la configuración: es el pico del mayor de ellos
+    				// (el principal o alguno de sus trabajadores, ya esperados por él)
+    				int estado;
+    				struct rusage uso;
+    				wait4(pid, &estado, 0, &uso);
+
+    				if (!bLeido or !WIFEXITED(estado) or WEXITSTATUS(estado) != EXIT_SUCCESS) {
+    					printf("%10d %6d %9d %9d %12s\n", configuracion.nPatrones, configuracion.nCapas, configuracion.nNeuronas, configuracion.nProcesos, "fallo");
+    					fflush(stdout);
+    					continue;
+    				}
+
+    				if (iw == 0)
+    					tiempoBase = tiempo * configuracion.nProcesos;
+    				printf("%10d %6d %9d %9d", configuracion.nPatrones, configuracion.nCapas, configuracion.nNeuronas, configuracion.nProcesos);
+    				if (fvalue != NULL)
+    					printf(" %12.4f", tiempos[0]);
+    				else
+    					printf(" %12s", "-");
+    				printf(" %12.4f %14.0f %19.1f", tiempo, configuracion.nPatrones / tiempo, uso.ru_maxrss / 1024.0);
+    				if (tiempoBase > 0.0)
+    					printf(" %10.1f%%\n", 100.0 * tiempoBase / (tiempo * configuracion.nProcesos));
+    				else
+    					printf(" %11s\n", "-");
+    				fflush(stdout);
+    			}
+    		}
+    	}
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/*********************************************************************
+ * File  : canalizacionPatrones.cpp
+ * Date  : 2016
+ *********************************************************************/
+
+#include <vector>
+#include <algorithm>
+
+// Inclusión del archivo de cabecera de CanalizacionPatrones
+#include "canalizacionPatrones.hpp"
+
+// ------------------------------
+// CONSTRUCTOR: reservar los bloques y lanzar el hilo productor
+imc::CanalizacionPatrones::CanalizacionPatrones(const Vista &vista, const int &tamBloque, const bool &barajar, const unsigned int &semilla)
+	: generador(semilla)
+{
+	this->pDatos = vista.pDatos;
+	this->permutacion = vista.indices;
+	this->nTamBloque = std::max(1, std::min(tamBloque, (int) this->permutacion.size()));
+	this->bBarajar = barajar;
+	this->nBloqueConsumidor = 0;
+	this->bParar = false;
+
+	// Los bloques se reservan una única vez con su tamaño máximo
+	for(int b=0; b<2; b++) {
+		this->bloques[b].nNumPatrones = 0;
+		this->bloques[b].bUltimoEpoca = false;
+		this->bloques[b].bLleno = false;
+		this->bloques[b].entradas.resize(this->nTamBloque * this->pDatos->nNumEntradas);
+		this->bloques[b].clases.resize(this->nTamBloque);
+	}
+
+	this->productor = std::thread(&CanalizacionPatrones::producir, this);
+}
+
+// ------------------------------
+// DESTRUCTOR: detener el hilo productor
+imc::CanalizacionPatrones::~CanalizacionPatrones() {
+
+	{
+		std::lock_guard<std::mutex> lock(this->cerrojo);
+		this->bParar = true;
+	}
+	this->condicion.notify_all();
+
+	if (this->productor.joinable())
+		this->productor.join();
+}
+
+// ------------------------------
+// Bucle del hilo productor: baraja, agrupa y entrega bloques indefinidamente
+void imc::CanalizacionPatrones::producir() {
+
+	int nBloqueProductor = 0;
+
+	for(;;) {
+		// Nueva época: se genera la permutación de los patrones
+		if (this->bBarajar)
+			std::shuffle(this->permutacion.begin(), this->permutacion.end(), this->generador);
+
+		// Cada época entrega al menos un bloque, aunque la vista esté vacía (un único bloque sin patrones
+		// marcado como último), para que el entrenador nunca se quede esperando
+		int inicio = 0;
+		do {
+			BloquePatrones &bloque = this->bloques[nBloqueProductor];
+
+			// Se espera a que el entrenador haya liberado el bloque
+			{
+				std::unique_lock<std::mutex> lock(this->cerrojo);
+				this->condicion.wait(lock, [&]{ return this->bParar or !bloque.bLleno; });
+				if (this->bParar)
+					return;
+			}
+
+			// El bloque pertenece ahora al productor: se copian los patrones fuera del cerrojo
+			int fin = std::min(inicio + this->nTamBloque, (int) this->permutacion.size());
+			bloque.nNumPatrones = fin - inicio;
+			bloque.bUltimoEpoca = (fin == (int) this->permutacion.size());
+
+			double * pEntradas = bloque.entradas.data();
+			for(int p=inicio; p<fin; p++) {
+				int indice = this->permutacion[p];
+				pEntradas = std::copy(this->pDatos->entradas[indice].begin(), this->pDatos->entradas[indice].end(), pEntradas);
+				bloque.clases[p-inicio] = this->pDatos->clases[indice];
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(this->cerrojo);
+				bloque.bLleno = true;
+			}
+			this->condicion.notify_all();
+
+			nBloqueProductor ^= 1;
+			inicio += this->nTamBloque;
+		} while (inicio < (int) this->permutacion.size());
+	}
+}
+
+// ------------------------------
+// Esperar al siguiente bloque preparado por el productor y devolverlo
+const imc::BloquePatrones & imc::CanalizacionPatrones::siguienteBloque() {
+
+	BloquePatrones &bloque = this->bloques[this->nBloqueConsumidor];
+
+	std::unique_lock<std::mutex> lock(this->cerrojo);
+	this->condicion.wait(lock, [&]{ return bloque.bLleno; });
+
+	return bloque;
+}
+
+// ------------------------------
+// Devolver al productor el bloque obtenido con siguienteBloque()
+void imc::CanalizacionPatrones::liberarBloque() {
+
+	{
+		std::lock_guard<std::mutex> lock(this->cerrojo);
+		this->bloques[this->nBloqueConsumidor].bLleno = false;
+	}
+	this->condicion.notify_all();
+
+	this->nBloqueConsumidor ^= 1;
+}
@@ -0,0 +1,73 @@
+/*********************************************************************
+ * File  : canalizacionPatrones.hpp
+ * Date  : 2016
+ *********************************************************************/
+
+#ifndef _CANALIZACIONPATRONES_HPP_
+#define _CANALIZACIONPATRONES_HPP_
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "perceptronMulticapa.hpp"
+
+namespace imc {
+
+// Bloque de patrones contiguos preparado por el productor
+// ---------------------
+struct BloquePatrones {
+	int nNumPatrones;             /* Número de patrones válidos en el bloque */
+	bool bUltimoEpoca;            /* ¿Es el último bloque de la época? */
+	bool bLleno;                  /* ¿Está listo para ser consumido? */
+	std::vector<double> entradas; /* Entradas de los patrones (nNumPatrones x nNumEntradas) */
+	std::vector<int> clases;      /* Clases de los patrones (nNumPatrones) */
+};
+
+// Canalización de patrones para el entrenamiento
+// Un hilo productor genera en cada época una permutación de los patrones, los copia
+// en bloques contiguos y los entrega al entrenador a través de un doble buffer acotado
+class CanalizacionPatrones {
+private:
+	Datos * pDatos;      /* Conjunto de datos del que se extraen los patrones */
+	int nTamBloque;      /* Número de patrones por bloque */
+	bool bBarajar;       /* ¿Se baraja el orden de los patrones en cada época? */
+	std::mt19937 generador; /* Generador para las permutaciones (una semilla por ejecución) */
+
+	std::vector<int> permutacion; /* Orden de los patrones de la vista en la época actual */
+	BloquePatrones bloques[2];    /* Doble buffer de bloques */
+	int nBloqueConsumidor;        /* Bloque que leerá el entrenador a continuación */
+
+	std::thread productor;
+	std::mutex cerrojo;
+	std::condition_variable condicion;
+	bool bParar;
+
+	// Bucle del hilo productor: baraja, agrupa y entrega bloques indefinidamente
+	void producir();
+
+public:
+
+	// CONSTRUCTOR: reservar los bloques y lanzar el hilo productor
+	// Los patrones se toman de la vista pasada como argumento (todo el conjunto o un subconjunto)
+	CanalizacionPatrones(const Vista &vista, const int &tamBloque, const bool &barajar, const unsigned int &semilla);
+
+	// DESTRUCTOR: detener el hilo productor
+	~CanalizacionPatrones();
+
+	inline Datos * getDatos() const {
+		return this->pDatos;
+	}
+
+	// Esperar al siguiente bloque preparado por el productor y devolverlo
+	const BloquePatrones & siguienteBloque();
+
+	// Devolver al productor el bloque obtenido con siguienteBloque()
+	void liberarBloque();
+};
+
+};
+
+#endif
@@ -0,0 +1,197 @@
+//============================================================================
+// Introducción a los Modelos Computacionales
+// Name        : MLP-Classification (generador de carga para el servidor de inferencia)
+// Author      : Carlos Gómez Pino
+// Version     : 2016
+// Copyright   : Universidad de Córdoba
+//============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Inclusión de la clase PerceptrónMulticapa (para leer los patrones)
+#include "perceptronMulticapa.hpp"
+
+// Conectar con el servidor en el socket Unix indicado (devuelve -1 si no es posible)
+static int conectar(const char * ruta) {
+
+	int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (descriptor == -1)
+		return -1;
+
+	struct sockaddr_un direccion;
+	memset(&direccion, 0, sizeof(direccion));
+	direccion.sun_family = AF_UNIX;
+	strncpy(direccion.sun_path, ruta, sizeof(direccion.sun_path) - 1);
+
+	if (connect(descriptor, (struct sockaddr *) &direccion, sizeof(direccion)) == -1) {
+		close(descriptor);
+		return -1;
+	}
+	return descriptor;
+}
+
+// Enviar una línea y esperar la línea de respuesta
+static bool peticion(const int &descriptor, FILE * entrada, const std::string &linea, std::string &respuesta) {
+
+	size_t escritos = 0;
+	while (escritos < linea.size()) {
+		ssize_t n = write(descriptor, linea.data() + escritos, linea.size() - escritos);
+		if (n <= 0)
+			return false;
+		escritos += n;
+	}
+
+	char * buffer = NULL;
+	size_t tam = 0;
+	bool bLeido = (getline(&buffer, &tam, entrada) != -1);
+	if (bLeido)
+		respuesta = buffer;
+	free(buffer);
+	return bLeido;
+}
+
+int main(int argc, char **argv) {
+
+    /* Valores de entrada del programa */
+
+    // Ruta del socket del servidor
+    char *svalue = NULL;
+
+    // Fichero con los patrones que se envían
+    char *dvalue = NULL;
+
+    // Nº de clientes concurrentes
+    int cvalue = 4;
+
+    // Nº de peticiones por cliente
+    int nvalue = 1000;
+
+    // Indica si se detiene el servidor al terminar
+    bool pflag = false;
+
+    int c;
+    while ((c = getopt (argc, argv, "s:d:c:n:p")) != -1) {
+    	switch(c) {
+    	case 's':
+    		svalue = optarg;
+    		break;
+    	case 'd':
+    		dvalue = optarg;
+    		break;
+    	case 'c':
+    		cvalue = atoi(optarg);
+    		break;
+    	case 'n':
+    		nvalue = atoi(optarg);
+    		break;
+    	case 'p':
+    		pflag = true;
+    		break;
+    	default:
+    		fprintf (stderr, "\n # Uso: %s -s socket -d datos.dat [-c clientes] [-n peticiones] [-p]\n", argv[0]);
+    		exit(-1);
+    	}
+    }
+
+    if (svalue == NULL or dvalue == NULL or cvalue < 1 or nvalue < 1) {
+    	fprintf (stderr, "\n # Uso: %s -s socket -d datos.dat [-c clientes] [-n peticiones] [-p]\n", argv[0]);
+    	exit(-1);
+    }
+
+    // Se preparan las líneas de los patrones una sola vez
+    imc::PerceptronMulticapa mlp;
+    imc::Datos * pDatos = mlp.leerDatos(dvalue);
+    if (pDatos == NULL)
+    	exit(-1);
+    std::vector<std::string> lineas(pDatos->nNumPatrones);
+    for(int p=0; p<pDatos->nNumPatrones; p++) {
+    	std::ostringstream linea;
+    	for(int j=0; j<pDatos->nNumEntradas; j++)
+    		linea << ((j > 0) ? " " : "") << pDatos->entradas[p][j];
+    	linea << "\n";
+    	lineas[p] = linea.str();
+    }
+
+    // Latencias medidas por cada cliente (microsegundos)
+    std::vector<std::vector<double> > latencias(cvalue);
+    std::vector<int> fallos(cvalue, 0);
+
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> clientes;
+    for(int k=0; k<cvalue; k++) {
+    	clientes.push_back(std::thread([&, k]() {
+    		int descriptor = conectar(svalue);
+    		if (descriptor == -1) {
+    			fallos[k] = nvalue;
+    			return;
+    		}
+    		FILE * entrada = fdopen(dup(descriptor), "r");
+
+    		std::string respuesta;
+    		for(int r=0; r<nvalue; r++) {
+    			const std::string &linea = lineas[((size_t) k * nvalue + r) % lineas.size()];
+    			std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+    			if (!peticion(descriptor, entrada, linea, respuesta) or respuesta.compare(0, 5, "ERROR") == 0) {
+    				fallos[k]++;
+    				continue;
+    			}
+    			latencias[k].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count());
+    		}
+
+    		fclose(entrada);
+    		close(descriptor);
+    	}));
+    }
+    for(int k=0; k<cvalue; k++)
+    	clientes[k].join();
+
+    double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+
+    // Se juntan las latencias de todos los clientes
+    std::vector<double> todas;
+    int nFallos = 0;
+    for(int k=0; k<cvalue; k++) {
+    	todas.insert(todas.end(), latencias[k].begin(), latencias[k].end());
+    	nFallos += fallos[k];
+    }
+    std::sort(todas.begin(), todas.end());
+
+    std::cout << "\n***************" << std::endl;
+    std::cout << " Prueba de carga" << std::endl;
+    std::cout << "***************" << std::endl;
+    std::cout << " > Clientes.....................: " << cvalue << std::endl;
+    std::cout << " > Peticiones correctas.........: " << todas.size() << " (" << nFallos << " fallidas)" << std::endl;
+    std::cout << " > Rendimiento..................: " << todas.size() / segundos << " peticiones/s" << std::endl;
+    if (!todas.empty()) {
+    	std::cout << " > Latencia p50 (cliente).......: " << todas[(todas.size() - 1) * 50 / 100] << " us" << std::endl;
+    	std::cout << " > Latencia p99 (cliente).......: " << todas[(todas.size() - 1) * 99 / 100] << " us" << std::endl;
+    }
+
+    // Contadores del propio servidor y, si se pide, parada
+    int descriptor = conectar(svalue);
+    if (descriptor != -1) {
+    	FILE * entrada = fdopen(dup(descriptor), "r");
+    	std::string respuesta;
+    	if (peticion(descriptor, entrada, "#estadisticas\n", respuesta))
+    		std::cout << " > Servidor.....................: " << respuesta;
+    	if (pflag and write(descriptor, "#parar\n", 7) != 7)
+    		std::cerr << " # No se pudo detener el servidor." << std::endl;
+    	fclose(entrada);
+    	close(descriptor);
+    }
+
+    return (nFallos == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,271 @@
+/*********************************************************************
+ * File  : comunicador.cpp
+ * Date  : 2016
+ *********************************************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <vector>
+#include <ctime>
+#include <csignal>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// Inclusión del archivo de cabecera de Comunicador
+#include "comunicador.hpp"
+
+// Tiempo (segundos) tras el que una espera en un semáforo comprueba si los demás procesos siguen en marcha
+#define TIEMPO_COMPROBACION_PROCESOS 1
+
+// ------------------------------
+// Sumar el vector datos de todos los procesos, dejando el resultado en todos ellos (allreduce en anillo)
+void imc::Comunicador::sumarTodos(double * datos, const size_t &n) {
+
+	int nProcesos = getNumProcesos();
+	int rango = getRango();
+
+	if (nProcesos == 1)
+		return;
+
+	int derecha = (rango + 1) % nProcesos;
+	int izquierda = (rango - 1 + nProcesos) % nProcesos;
+
+	// El vector se divide en tantos segmentos como procesos
+	std::vector<size_t> inicio(nProcesos+1);
+	for(int s=0; s<=nProcesos; s++)
+		inicio[s] = (n * s) / nProcesos;
+
+	size_t tamMaximo = 0;
+	for(int s=0; s<nProcesos; s++)
+		tamMaximo = std::max(tamMaximo, inicio[s+1] - inicio[s]);
+	this->recepcion.resize(tamMaximo);
+
+	// Fase 1 (reduce-scatter): tras nProcesos-1 pasos, cada proceso tiene la suma completa de un segmento
+	for(int paso=0; paso<nProcesos-1; paso++) {
+		int sEnvio = (rango - paso + nProcesos) % nProcesos;
+		int sRecepcion = (rango - paso - 1 + nProcesos) % nProcesos;
+		size_t nRecepcion = inicio[sRecepcion+1] - inicio[sRecepcion];
+
+		enviarRecibir(datos + inicio[sEnvio], inicio[sEnvio+1] - inicio[sEnvio], derecha, this->recepcion.data(), nRecepcion, izquierda);
+
+		for(size_t i=0; i<nRecepcion; i++)
+			datos[inicio[sRecepcion] + i] += this->recepcion[i];
+	}
+
+	// Fase 2 (allgather): los segmentos ya sumados recorren el anillo hasta llegar a todos los procesos
+	for(int paso=0; paso<nProcesos-1; paso++) {
+		int sEnvio = (rango - paso + 1 + nProcesos) % nProcesos;
+		int sRecepcion = (rango - paso + nProcesos) % nProcesos;
+
+		enviarRecibir(datos + inicio[sEnvio], inicio[sEnvio+1] - inicio[sEnvio], derecha, datos + inicio[sRecepcion], inicio[sRecepcion+1] - inicio[sRecepcion], izquierda);
+	}
+}
+
+// ------------------------------
+// CONSTRUCTOR: comunicador sin memoria reservada
+imc::ComunicadorMemoriaCompartida::ComunicadorMemoriaCompartida() {
+	this->nRango = 0;
+	this->nNumProcesos = 1;
+	this->pCanales = NULL;
+	this->nPidPrincipal = getpid();
+}
+
+// ------------------------------
+// DESTRUCTOR: liberar la memoria compartida
+imc::ComunicadorMemoriaCompartida::~ComunicadorMemoriaCompartida() {
+
+	if (this->pCanales != NULL) {
+		// Solo el proceso principal destruye los semáforos, cuando ya han terminado los trabajadores
+		if (this->nRango == 0)
+			for(int c=0; c<this->nNumProcesos; c++) {
+				sem_destroy(&this->pCanales[c].lleno);
+				sem_destroy(&this->pCanales[c].vacio);
+			}
+		munmap(this->pCanales, sizeof(CanalMemoria) * this->nNumProcesos);
+	}
+}
+
+// ------------------------------
+// Canal de origen a destino, que deben ser vecinos en el anillo
+imc::CanalMemoria & imc::ComunicadorMemoriaCompartida::canal(const int &origen, const int &destino) {
+
+	if (destino != (origen + 1) % this->nNumProcesos) {
+		std::cerr << "\n # El comunicador en memoria compartida solo une cada proceso con el siguiente del anillo (" << origen << " => " << destino << ")." << std::endl;
+		abort();
+	}
+	return this->pCanales[origen];
+}
+
+// ------------------------------
+// Reservar la memoria compartida y los canales para nProcesos procesos
+int imc::ComunicadorMemoriaCompartida::inicializar(const int &nProcesos) {
+
+	this->nNumProcesos = nProcesos;
+	this->nRango = 0;
+	this->nPidPrincipal = getpid();
+
+	// Memoria anónima compartida: la heredan los procesos creados después con fork()
+	void * memoria = mmap(NULL, sizeof(CanalMemoria) * nProcesos, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memoria == MAP_FAILED) {
+		std::cerr << "\n # No se pudo reservar la memoria compartida: " << strerror(errno) << std::endl;
+		this->pCanales = NULL;
+		return EXIT_FAILURE;
+	}
+	this->pCanales = (CanalMemoria *) memoria;
+
+	for(int c=0; c<nProcesos; c++) {
+		if (sem_init(&this->pCanales[c].lleno, 1, 0) == -1 or sem_init(&this->pCanales[c].vacio, 1, 1) == -1) {
+			std::cerr << "\n # No se pudieron crear los semáforos compartidos: " << strerror(errno) << std::endl;
+			return EXIT_FAILURE;
+		}
+		this->pCanales[c].n = 0;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// ------------------------------
+// Crear los nNumProcesos-1 procesos trabajadores y devolver el rango del proceso que vuelve de la llamada
+int imc::ComunicadorMemoriaCompartida::lanzarProcesos() {
+
+	for(int r=1; r<this->nNumProcesos; r++) {
+		pid_t pid = fork();
+		if (pid == -1) {
+			std::cerr << "\n # No se pudo crear el proceso trabajador " << r << ": " << strerror(errno) << std::endl;
+			exit(-1);
+		}
+		if (pid == 0) {
+			this->nRango = r;
+			this->hijos.clear();
+			return r;
+		}
+		this->hijos.push_back(pid);
+	}
+
+	return 0;
+}
+
+// ------------------------------
+// Esperar a que terminen los procesos trabajadores (solo en el principal)
+// Si alguno termina de forma anómala, se terminan los demás y se sale con error
+void imc::ComunicadorMemoriaCompartida::esperarProcesos() {
+
+	// Se espera a cualquiera de ellos, en el orden en que terminen, para detectar enseguida un fallo
+	// aunque los demás se hayan quedado bloqueados esperando sus mensajes
+	while (!this->hijos.empty()) {
+		int estado;
+		pid_t pid = waitpid(-1, &estado, 0);
+		if (pid == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		std::vector<int>::iterator hijo = std::find(this->hijos.begin(), this->hijos.end(), pid);
+		if (hijo == this->hijos.end())
+			continue;
+		this->hijos.erase(hijo);
+		if (!WIFEXITED(estado) or WEXITSTATUS(estado) != EXIT_SUCCESS)
+			abortar(pid, estado);
+	}
+	this->hijos.clear();
+}
+
+// ------------------------------
+// Esperar en un semáforo, comprobando los demás procesos cada cierto tiempo
+void imc::ComunicadorMemoriaCompartida::esperarSemaforo(sem_t * semaforo) {
+
+	for(;;) {
+		struct timespec limite;
+		clock_gettime(CLOCK_REALTIME, &limite);
+		limite.tv_sec += TIEMPO_COMPROBACION_PROCESOS;
+
+		if (sem_timedwait(semaforo, &limite) == 0)
+			return;
+		if (errno == ETIMEDOUT)
+			comprobarProcesos();
+		else if (errno != EINTR) {
+			std::cerr << "\n # Error al esperar un mensaje de otro proceso: " << strerror(errno) << std::endl;
+			exit(-1);
+		}
+	}
+}
+
+// ------------------------------
+// Comprobar que los demás procesos siguen en marcha y terminar todos si alguno ha fallado
+// El principal comprueba sus trabajadores; cada trabajador comprueba que el principal sigue siendo su padre
+void imc::ComunicadorMemoriaCompartida::comprobarProcesos() {
+
+	if (this->nRango > 0) {
+		if (getppid() != this->nPidPrincipal) {
+			std::cerr << "\n # El proceso " << this->nRango << " se detiene: el proceso principal ha terminado." << std::endl;
+			_exit(EXIT_FAILURE);
+		}
+		return;
+	}
+
+	for(size_t i=0; i<this->hijos.size(); ) {
+		int estado;
+		pid_t pid = this->hijos[i];
+		if (waitpid(pid, &estado, WNOHANG) != pid) {
+			i++;
+			continue;
+		}
+
+		// Un trabajador que termina bien ya no se espera; uno que falla detiene el entrenamiento
+		this->hijos.erase(this->hijos.begin() + i);
+		if (!WIFEXITED(estado) or WEXITSTATUS(estado) != EXIT_SUCCESS)
+			abortar(pid, estado);
+	}
+}
+
+// ------------------------------
+// Terminar los procesos trabajadores que queden y salir con error (solo en el principal)
+void imc::ComunicadorMemoriaCompartida::abortar(const int &pid, const int &estado) {
+
+	if (WIFSIGNALED(estado))
+		std::cerr << "\n # El proceso trabajador " << pid << " ha terminado por la señal " << WTERMSIG(estado) << " (" << strsignal(WTERMSIG(estado)) << ")." << std::endl;
+	else
+		std::cerr << "\n # El proceso trabajador " << pid << " ha terminado con el código " << WEXITSTATUS(estado) << "." << std::endl;
+	std::cerr << " # Se detiene el entrenamiento distribuido." << std::endl;
+
+	for(size_t i=0; i<this->hijos.size(); i++)
+		kill(this->hijos[i], SIGKILL);
+	for(size_t i=0; i<this->hijos.size(); i++)
+		waitpid(this->hijos[i], NULL, 0);
+	this->hijos.clear();
+
+	exit(-1);
+}
+
+// ------------------------------
+// Enviar y recibir por trozos del tamaño de un canal, alternando envío y recepción para no bloquearse
+void imc::ComunicadorMemoriaCompartida::enviarRecibir(const double * envio, const size_t &nEnvio, const int &destino, double * recepcion, const size_t &nRecepcion, const int &origen) {
+
+	CanalMemoria &salida = canal(this->nRango, destino);
+	CanalMemoria &entrada = canal(origen, this->nRango);
+	const size_t capacidad = sizeof(salida.datos) / sizeof(double);
+
+	size_t enviados = 0, recibidos = 0;
+	while (enviados < nEnvio or recibidos < nRecepcion) {
+		if (enviados < nEnvio) {
+			size_t n = std::min(capacidad, nEnvio - enviados);
+			esperarSemaforo(&salida.vacio);
+			memcpy(salida.datos, envio + enviados, n * sizeof(double));
+			salida.n = n;
+			sem_post(&salida.lleno);
+			enviados += n;
+		}
+
+		if (recibidos < nRecepcion) {
+			esperarSemaforo(&entrada.lleno);
+			memcpy(recepcion + recibidos, entrada.datos, entrada.n * sizeof(double));
+			recibidos += entrada.n;
+			sem_post(&entrada.vacio);
+		}
+	}
+}
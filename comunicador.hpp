@@ -0,0 +1,105 @@
+/*********************************************************************
+ * File  : comunicador.hpp
+ * Date  : 2016
+ *********************************************************************/
+
+#ifndef _COMUNICADOR_HPP_
+#define _COMUNICADOR_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <semaphore.h>
+
+namespace imc {
+
+// Capa de comunicación entre los procesos del entrenamiento distribuido
+// Las implementaciones concretas solo tienen que saber intercambiar mensajes entre dos procesos;
+// la suma en anillo (allreduce) se construye sobre ese intercambio
+class Comunicador {
+private:
+	std::vector<double> recepcion; /* Buffer para los segmentos recibidos en la suma en anillo */
+
+public:
+
+	virtual ~Comunicador() {}
+
+	// Índice de este proceso (0 => proceso principal)
+	virtual int getRango() const = 0;
+
+	// Número total de procesos
+	virtual int getNumProcesos() const = 0;
+
+	// Enviar nEnvio valores al proceso destino y, a la vez, recibir nRecepcion valores del proceso origen
+	virtual void enviarRecibir(const double * envio, const size_t &nEnvio, const int &destino, double * recepcion, const size_t &nRecepcion, const int &origen) = 0;
+
+	// Sumar el vector datos de todos los procesos, dejando el resultado en todos ellos (allreduce en anillo)
+	void sumarTodos(double * datos, const size_t &n);
+};
+
+// Canal de un proceso a otro en memoria compartida (un único mensaje en vuelo)
+struct CanalMemoria {
+	sem_t lleno;  /* Hay un mensaje pendiente de leer */
+	sem_t vacio;  /* El canal está libre para escribir */
+	size_t n;     /* Número de valores del mensaje */
+	double datos[4096];
+};
+
+// Comunicador entre procesos del mismo equipo mediante memoria compartida POSIX
+// La memoria se reserva antes de crear los procesos, que la heredan al hacer fork()
+// Solo hay un canal por proceso, hacia su vecino de la derecha en el anillo, que es el único intercambio de sumarTodos
+// Las esperas se interrumpen periódicamente para comprobar que los demás procesos siguen vivos: si alguno ha
+// terminado de forma anómala, se detienen todos en lugar de quedarse bloqueados
+class ComunicadorMemoriaCompartida : public Comunicador {
+private:
+	int nRango;        /* Índice de este proceso */
+	int nNumProcesos;  /* Número total de procesos */
+	CanalMemoria * pCanales; /* Canal de cada proceso hacia el siguiente del anillo (nNumProcesos canales) */
+	std::vector<int> hijos;  /* Identificadores de los procesos trabajadores que siguen en marcha (solo en el principal) */
+	int nPidPrincipal;       /* Identificador del proceso principal */
+
+	// Canal de origen a destino, que deben ser vecinos en el anillo
+	CanalMemoria & canal(const int &origen, const int &destino);
+
+	// Esperar en un semáforo, comprobando los demás procesos cada cierto tiempo
+	void esperarSemaforo(sem_t * semaforo);
+
+	// Comprobar que los demás procesos siguen en marcha y terminar todos si alguno ha fallado
+	void comprobarProcesos();
+
+	// Terminar los procesos trabajadores que queden y salir con error (solo en el principal)
+	void abortar(const int &pid, const int &estado);
+
+public:
+
+	// CONSTRUCTOR: comunicador sin memoria reservada
+	ComunicadorMemoriaCompartida();
+
+	// DESTRUCTOR: liberar la memoria compartida
+	~ComunicadorMemoriaCompartida();
+
+	// Reservar la memoria compartida y los canales para nProcesos procesos
+	int inicializar(const int &nProcesos);
+
+	// Crear los nNumProcesos-1 procesos trabajadores y devolver el rango del proceso que vuelve de la llamada
+	int lanzarProcesos();
+
+	// Esperar a que terminen los procesos trabajadores (solo en el principal)
+	// Si alguno termina de forma anómala, se terminan los demás y se sale con error
+	void esperarProcesos();
+
+	inline int getRango() const {
+		return this->nRango;
+	}
+
+	inline int getNumProcesos() const {
+		return this->nNumProcesos;
+	}
+
+	// Enviar y recibir por trozos del tamaño de un canal, alternando envío y recepción para no bloquearse
+	// destino y origen deben ser los vecinos de la derecha y de la izquierda en el anillo
+	void enviarRecibir(const double * envio, const size_t &nEnvio, const int &destino, double * recepcion, const size_t &nRecepcion, const int &origen);
+};
+
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*********************************************************************
+ * File  : conjuntoRedes.cpp
+ * Date  : 2016
+ *********************************************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// Inclusión del archivo de cabecera de ConjuntoRedes
+#include "conjuntoRedes.hpp"
+
+// Nº de patrones que se propagan a la vez por todos los miembros
+#define TAM_LOTE_CONJUNTO 64
+
+// ------------------------------
+// CONSTRUCTOR: conjunto vacío
+imc::ConjuntoRedes::ConjuntoRedes() {
+	this->nNumMiembros = 0;
+	this->nNumCapas = 0;
+	this->bSesgo = false;
+	this->bSoftmax = false;
+}
+
+// ------------------------------
+// Añadir al conjunto una copia de los pesos actuales de una red
+// Devuelve EXIT_FAILURE si la topología no coincide con la de los miembros anteriores
+int imc::ConjuntoRedes::agregarRed(const PerceptronMulticapa &red) {
+
+	// El primer miembro fija la topología del conjunto
+	if (this->nNumMiembros == 0) {
+		this->nNumCapas = red.getNumCapas();
+		this->bSesgo = red.isSesgo();
+		this->bSoftmax = red.isSoftmax();
+		this->vTopologia.resize(this->nNumCapas);
+		for(int h=0; h<this->nNumCapas; h++)
+			this->vTopologia[h] = red.getNumNeuronas(h);
+		this->pesos.resize(this->nNumCapas);
+		this->salidasCapa.resize(this->nNumCapas);
+	}else{
+		if (red.getNumCapas() != this->nNumCapas or red.isSesgo() != this->bSesgo or red.isSoftmax() != this->bSoftmax)
+			return EXIT_FAILURE;
+		for(int h=0; h<this->nNumCapas; h++)
+			if (red.getNumNeuronas(h) != this->vTopologia[h])
+				return EXIT_FAILURE;
+	}
+
+	// Los pesos del nuevo miembro se añaden a continuación de los anteriores en cada capa
+	for(int h=1; h<this->nNumCapas; h++) {
+		size_t tamMiembro = this->vTopologia[h] * (this->vTopologia[h-1] + this->bSesgo);
+		this->pesos[h].resize(this->pesos[h].size() + tamMiembro);
+		red.copiarPesosCapa(h, &this->pesos[h][this->nNumMiembros * tamMiembro]);
+	}
+
+	this->nNumMiembros++;
+
+	return EXIT_SUCCESS;
+}
+
+// ------------------------------
+// Propagar un lote de nPatrones patrones (entradas por filas) por todos los miembros a la vez
+// Cada capa es un único producto de la matriz apilada de todos los miembros por el lote: en la primera capa todos
+// los miembros leen la misma entrada y en las siguientes la matriz es diagonal por bloques (cada bloque de filas
+// lee solo las salidas de su miembro), así que los bloques nulos no se guardan ni se recorren
+// Al terminar, salidasCapa[nNumCapas-1] contiene, para cada patrón, las salidas de cada miembro una tras otra
+void imc::ConjuntoRedes::propagar(const double * entradas, const int &nPatrones) {
+
+	for(int h=1; h<this->nNumCapas; h++) {
+		int nNumEntradas = this->vTopologia[h-1];
+		int nNumColumnas = nNumEntradas + this->bSesgo;
+		int nNumFilas = this->nNumMiembros * this->vTopologia[h];
+		bool bSalidaSoftmax = (h == this->nNumCapas-1 and this->bSoftmax);
+
+		// Separación entre patrones de la entrada de la capa y entre las entradas de dos miembros consecutivos
+		const double * x = (h == 1) ? entradas : this->salidasCapa[h-1].data();
+		size_t nSeparacionPatron = (h == 1) ? nNumEntradas : (size_t) this->nNumMiembros * nNumEntradas;
+		int nSeparacionMiembro = (h == 1) ? 0 : nNumEntradas;
+
+		this->salidasCapa[h].resize((size_t) nPatrones * nNumFilas);
+		double * salida = this->salidasCapa[h].data();
+
+		// Cada fila de la matriz apilada se aplica a todos los patrones del lote seguidos
+		const double * w = this->pesos[h].data();
+		for(int r=0; r<nNumFilas; r++, w+=nNumColumnas) {
+			const double * xMiembro = x + (size_t) (r / this->vTopologia[h]) * nSeparacionMiembro;
+			for(int p=0; p<nPatrones; p++) {
+				const double * xp = xMiembro + p * nSeparacionPatron;
+				double net = 0.0;
+				for(int i=0; i<nNumEntradas; i++)
+					net += w[i] * xp[i];
+				if (this->bSesgo)
+					net += w[nNumEntradas];
+
+				salida[(size_t) p * nNumFilas + r] = bSalidaSoftmax ? exp(net) : 1 / (1 + exp(-net));
+			}
+		}
+
+		// Normalización de la función softmax de cada miembro para cada patrón
+		if (bSalidaSoftmax) {
+			for(size_t b=0; b<(size_t) nPatrones * this->nNumMiembros; b++) {
+				double * salidaMiembro = salida + b * this->vTopologia[h];
+				double sumatorioSoftmax = 0.0;
+				for(int j=0; j<this->vTopologia[h]; j++)
+					sumatorioSoftmax += salidaMiembro[j];
+				for(int j=0; j<this->vTopologia[h]; j++)
+					salidaMiembro[j] /= sumatorioSoftmax;
+			}
+		}
+	}
+}
+
+// ------------------------------
+// Probar el conjunto con los patrones de una vista, imprimir la matriz de confusión y devolver el CCR
+// modo=0 => media de las salidas de los miembros // modo=1 => votación por mayoría
+double imc::ConjuntoRedes::testClassification(const Vista &vistaTest, const int &modo) {
+
+	Datos * pDatosTest = vistaTest.pDatos;
+	int nNumSalidas = this->vTopologia[this->nNumCapas-1];
+
+	// Variable con el valor del ccr
+	double CCR = 0.0;
+
+	// Matriz de confusión
+	std::vector<std::vector<int> > matrizConfusion(nNumSalidas,std::vector<int>(nNumSalidas,0));
+
+	// Media de las salidas y votos recibidos por cada clase
+	std::vector<double> media(nNumSalidas);
+	std::vector<int> votos(nNumSalidas);
+
+	// Los patrones se propagan en lotes, copiados de forma contigua
+	int nNumEntradas = this->vTopologia[0];
+	std::vector<double> entradas((size_t) TAM_LOTE_CONJUNTO * nNumEntradas);
+
+	for(size_t k=0; k<vistaTest.indices.size(); k++) {
+		int i = vistaTest.indices[k];
+
+		int p = k % TAM_LOTE_CONJUNTO;
+		if (p == 0) {
+			int nPatrones = std::min((size_t) TAM_LOTE_CONJUNTO, vistaTest.indices.size() - k);
+			for(int q=0; q<nPatrones; q++)
+				std::copy(pDatosTest->entradas[vistaTest.indices[k+q]].begin(), pDatosTest->entradas[vistaTest.indices[k+q]].end(), &entradas[(size_t) q * nNumEntradas]);
+			propagar(entradas.data(), nPatrones);
+		}
+		const double * salidas = &this->salidasCapa[this->nNumCapas-1][(size_t) p * this->nNumMiembros * nNumSalidas];
+
+		std::fill(media.begin(), media.end(), 0.0);
+		std::fill(votos.begin(), votos.end(), 0);
+
+		for(int m=0; m<this->nNumMiembros; m++, salidas+=nNumSalidas) {
+			int indiceMiembro = 0;
+			for(int j=0; j<nNumSalidas; j++) {
+				media[j] += salidas[j] / this->nNumMiembros;
+				if (salidas[j] > salidas[indiceMiembro])
+					indiceMiembro = j;
+			}
+			votos[indiceMiembro]++;
+		}
+
+		// Índice con la clase que se espera que se encuentre un patrón
+		int indiceDeseado = pDatosTest->clases[i];
+
+		// Índice con la clase que predice el conjunto
+		// En la votación, los empates se deshacen con la media de las salidas
+		int indiceObtenido = 0;
+
+		for(int j=0; j<nNumSalidas; j++) {
+			if (modo == 1) {
+				if (votos[j] > votos[indiceObtenido] or (votos[j] == votos[indiceObtenido] and media[j] > media[indiceObtenido]))
+					indiceObtenido = j;
+			}else if (media[j] > media[indiceObtenido])
+				indiceObtenido = j;
+		}
+
+		// Se añade el patrón a la matriz de confusión
+		matrizConfusion[indiceDeseado][indiceObtenido]++;
+
+		if (indiceDeseado == indiceObtenido)
+			CCR++;
+	}
+
+	// Se imprime la matriz de confusión generada
+	imprimirMatrizConfusion(matrizConfusion);
+
+	// Se calcula el CCR final y se devuelve
+	return 100 * (CCR / vistaTest.indices.size());
+}
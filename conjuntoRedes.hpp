@@ -0,0 +1,56 @@
+/*********************************************************************
+ * File  : conjuntoRedes.hpp
+ * Date  : 2016
+ *********************************************************************/
+
+#ifndef _CONJUNTOREDES_HPP_
+#define _CONJUNTOREDES_HPP_
+
+#include <vector>
+
+#include "perceptronMulticapa.hpp"
+
+namespace imc {
+
+// Conjunto (ensemble) de redes con la misma topología
+// Los pesos de una misma capa de todos los miembros se apilan en una única matriz,
+// de forma que la propagación de un lote de patrones calcula las salidas de todos los miembros a la vez
+class ConjuntoRedes {
+private:
+	int nNumMiembros;            /* Número de redes del conjunto */
+	int nNumCapas;               /* Número de capas de cada red */
+	bool bSesgo;                 /* ¿Tienen sesgo las neuronas? */
+	bool bSoftmax;               /* ¿La capa de salida es softmax? */
+	std::vector<int> vTopologia; /* Número de neuronas por capa */
+
+	// Pesos apilados por capa (h>0): para cada miembro, una fila de (vTopologia[h-1] + bSesgo) pesos por neurona
+	std::vector<std::vector<double> > pesos;
+
+	// Salidas de cada capa para todos los miembros y los patrones del lote (vectores de trabajo de la propagación)
+	std::vector<std::vector<double> > salidasCapa;
+
+	// Propagar un lote de nPatrones patrones (entradas por filas) por todos los miembros a la vez
+	// Al terminar, salidasCapa[nNumCapas-1] contiene, para cada patrón, las salidas de cada miembro una tras otra
+	void propagar(const double * entradas, const int &nPatrones);
+
+public:
+
+	// CONSTRUCTOR: conjunto vacío
+	ConjuntoRedes();
+
+	inline int getNumMiembros() const {
+		return this->nNumMiembros;
+	}
+
+	// Añadir al conjunto una copia de los pesos actuales de una red
+	// Devuelve EXIT_FAILURE si la topología no coincide con la de los miembros anteriores
+	int agregarRed(const PerceptronMulticapa &red);
+
+	// Probar el conjunto con los patrones de una vista, imprimir la matriz de confusión y devolver el CCR
+	// modo=0 => media de las salidas de los miembros // modo=1 => votación por mayoría
+	double testClassification(const Vista &vistaTest, const int &modo);
+};
+
+};
+
+#endif
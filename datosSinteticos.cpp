@@ -0,0 +1,123 @@
+/*********************************************************************
+ * File  : datosSinteticos.cpp
+ * Date  : 2016
+ *********************************************************************/
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <charconv>
+#include <algorithm>
+
+// Inclusión del archivo de cabecera del generador de datos sintéticos
+#include "datosSinteticos.hpp"
+
+// Tamaño del buffer con el que se escriben los ficheros (se vuelca al llenarse)
+#define TAM_BUFFER_ESCRITURA (1 << 20)
+
+// ------------------------------
+// CONSTRUCTOR: problema con los centroides de la semilla indicada y patrones de la muestra indicada
+imc::GeneradorDatos::GeneradorDatos(const int &nEntradas, const int &nClases, const double &dispersion, const double &ruido, const unsigned int &semilla, const unsigned int &muestra) {
+	this->nNumEntradas = nEntradas;
+	this->nNumClases = nClases;
+	this->dDispersion = dispersion;
+	this->dRuido = ruido;
+
+	std::mt19937 generadorCentroides(semilla);
+	std::uniform_real_distribution<double> uniforme(-1.0, 1.0);
+	this->centroides.resize((size_t) nClases * nEntradas);
+	for(size_t i=0; i<this->centroides.size(); i++)
+		this->centroides[i] = uniforme(generadorCentroides);
+
+	std::seed_seq semillas = {semilla, muestra};
+	this->generador.seed(semillas);
+}
+
+// ------------------------------
+// Generar el siguiente patrón (entradas y clase)
+void imc::GeneradorDatos::generarPatron(double * entradas, int &clase) {
+
+	std::uniform_int_distribution<int> clases(0, this->nNumClases-1);
+	std::uniform_real_distribution<double> uniforme(0.0, 1.0);
+	std::normal_distribution<double> ruido(0.0, this->dRuido);
+
+	clase = clases(this->generador);
+	const double * centroide = &this->centroides[(size_t) clase * this->nNumEntradas];
+	for(int j=0; j<this->nNumEntradas; j++) {
+		if (this->dDispersion > 0.0 and uniforme(this->generador) < this->dDispersion)
+			entradas[j] = 0.0;
+		else
+			entradas[j] = centroide[j] + ruido(this->generador);
+	}
+}
+
+// ------------------------------
+// Generar un conjunto de datos en memoria con nPatrones patrones
+imc::Datos * imc::GeneradorDatos::generarDatos(const int &nPatrones) {
+
+	Datos * pDatos = new Datos;
+	pDatos->nNumEntradas = this->nNumEntradas;
+	pDatos->nNumSalidas = this->nNumClases;
+	pDatos->nNumPatrones = nPatrones;
+	pDatos->entradas.assign(nPatrones, std::vector<double>(this->nNumEntradas));
+	pDatos->clases.resize(nPatrones);
+
+	for(int p=0; p<nPatrones; p++)
+		generarPatron(pDatos->entradas[p].data(), pDatos->clases[p]);
+
+	return pDatos;
+}
+
+// ------------------------------
+// Escribir nPatrones patrones en un fichero con el formato .dat, sin guardarlos en memoria
+// Las entradas se escriben con 6 cifras significativas
+int imc::GeneradorDatos::guardarDatos(const char * archivo, const long &nPatrones) {
+
+	FILE * f = fopen(archivo, "w");
+	if (f == NULL) {
+		std::cerr << " # No se pudo crear el fichero " << archivo << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// Longitud máxima de una línea: cada entrada ocupa a lo sumo 14 caracteres más el separador
+	const size_t maxLinea = (size_t) this->nNumEntradas * 16 + (size_t) this->nNumClases * 2 + 64;
+
+	std::vector<char> buffer(std::max((size_t) TAM_BUFFER_ESCRITURA, 2 * maxLinea));
+	char * fin = buffer.data() + buffer.size();
+	char * pos = buffer.data() + snprintf(buffer.data(), buffer.size(), "%d %d %ld\n", this->nNumEntradas, this->nNumClases, nPatrones);
+	bool bCorrecto = true;
+
+	std::vector<double> entradas(this->nNumEntradas);
+	int clase;
+	for(long p=0; p<nPatrones and bCorrecto; p++) {
+		generarPatron(entradas.data(), clase);
+
+		if ((size_t) (fin - pos) < maxLinea) {
+			bCorrecto = (fwrite(buffer.data(), 1, pos - buffer.data(), f) == (size_t) (pos - buffer.data()));
+			pos = buffer.data();
+		}
+
+		for(int j=0; j<this->nNumEntradas; j++) {
+			if (entradas[j] == 0.0)
+				*pos++ = '0';
+			else
+				pos = std::to_chars(pos, fin, entradas[j], std::chars_format::general, 6).ptr;
+			*pos++ = ' ';
+		}
+		for(int k=0; k<this->nNumClases; k++) {
+			*pos++ = (k == clase) ? '1' : '0';
+			*pos++ = (k == this->nNumClases-1) ? '\n' : ' ';
+		}
+	}
+
+	if (bCorrecto)
+		bCorrecto = (fwrite(buffer.data(), 1, pos - buffer.data(), f) == (size_t) (pos - buffer.data()));
+	if (fclose(f) != 0)
+		bCorrecto = false;
+	if (!bCorrecto) {
+		std::cerr << " # Error al escribir el fichero " << archivo << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,47 @@
+/*********************************************************************
+ * File  : datosSinteticos.hpp
+ * Date  : 2016
+ *********************************************************************/
+
+#ifndef _DATOSSINTETICOS_HPP_
+#define _DATOSSINTETICOS_HPP_
+
+#include <vector>
+#include <random>
+
+#include "perceptronMulticapa.hpp"
+
+namespace imc {
+
+// Generador de problemas de clasificación sintéticos
+// Cada clase tiene un centroide aleatorio en [-1,1]^n y cada patrón es el centroide de su clase
+// más un ruido gaussiano; cada entrada vale 0 con probabilidad igual a la dispersión
+// Los centroides dependen solo de la semilla del problema y los patrones, además, de la muestra,
+// de forma que con la misma semilla y distinta muestra se obtienen conjuntos de train y test del mismo problema
+class GeneradorDatos {
+private:
+	int nNumEntradas;   /* Nº de entradas de cada patrón */
+	int nNumClases;     /* Nº de clases (una salida por clase) */
+	double dDispersion; /* Probabilidad de que una entrada valga 0 */
+	double dRuido;      /* Desviación típica del ruido alrededor del centroide */
+	std::vector<double> centroides; /* Centroides de las clases (nNumClases x nNumEntradas) */
+	std::mt19937 generador;         /* Generador de los patrones */
+
+public:
+
+	// CONSTRUCTOR: problema con los centroides de la semilla indicada y patrones de la muestra indicada
+	GeneradorDatos(const int &nEntradas, const int &nClases, const double &dispersion, const double &ruido, const unsigned int &semilla, const unsigned int &muestra);
+
+	// Generar el siguiente patrón (entradas y clase)
+	void generarPatron(double * entradas, int &clase);
+
+	// Generar un conjunto de datos en memoria con nPatrones patrones
+	Datos * generarDatos(const int &nPatrones);
+
+	// Escribir nPatrones patrones en un fichero con el formato .dat, sin guardarlos en memoria
+	int guardarDatos(const char * archivo, const long &nPatrones);
+};
+
+};
+
+#endif
@@ -0,0 +1,93 @@
+//============================================================================
+// Introducción a los Modelos Computacionales
+// Name        : MLP-Classification (generador de conjuntos de datos sintéticos)
+// Author      : Carlos Gómez Pino
+// Version     : 2016
+// Copyright   : Universidad de Córdoba
+//============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <chrono>
+
+// Inclusión del generador de datos sintéticos
+#include "datosSinteticos.hpp"
+
+int main(int argc, char **argv) {
+
+    /* Valores de entrada del programa */
+
+    // Fichero en el que se escriben los patrones
+    char *ovalue = NULL;
+
+    // Nº de entradas
+    int nvalue = 10;
+
+    // Nº de clases
+    int cvalue = 3;
+
+    // Nº de patrones
+    long pvalue = 1000;
+
+    // Proporción de entradas que valen 0
+    double dvalue = 0.0;
+
+    // Desviación típica del ruido alrededor de los centroides
+    double rvalue = 0.5;
+
+    // Semilla del problema (centroides) y nº de muestra (patrones)
+    unsigned int svalue = 1;
+    unsigned int mvalue = 0;
+
+    int c;
+    while ((c = getopt (argc, argv, "o:n:c:p:d:r:s:m:")) != -1) {
+    	switch(c) {
+    	case 'o':
+    		ovalue = optarg;
+    		break;
+    	case 'n':
+    		nvalue = atoi(optarg);
+    		break;
+    	case 'c':
+    		cvalue = atoi(optarg);
+    		break;
+    	case 'p':
+    		pvalue = atol(optarg);
+    		break;
+    	case 'd':
+    		dvalue = atof(optarg);
+    		break;
+    	case 'r':
+    		rvalue = atof(optarg);
+    		break;
+    	case 's':
+    		svalue = strtoul(optarg, NULL, 10);
+    		break;
+    	case 'm':
+    		mvalue = strtoul(optarg, NULL, 10);
+    		break;
+    	default:
+    		fprintf (stderr, "\n # Uso: %s -o datos.dat [-n entradas] [-c clases] [-p patrones] [-d dispersión] [-r ruido] [-s semilla] [-m muestra]\n", argv[0]);
+    		exit(-1);
+    	}
+    }
+
+    if (ovalue == NULL or nvalue < 1 or cvalue < 2 or pvalue < 1 or dvalue < 0.0 or dvalue >= 1.0 or rvalue < 0.0) {
+    	fprintf (stderr, "\n # Uso: %s -o datos.dat [-n entradas] [-c clases] [-p patrones] [-d dispersión] [-r ruido] [-s semilla] [-m muestra]\n", argv[0]);
+    	exit(-1);
+    }
+
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+
+    imc::GeneradorDatos generador(nvalue, cvalue, dvalue, rvalue, svalue, mvalue);
+    if (generador.guardarDatos(ovalue, pvalue) == EXIT_FAILURE)
+    	exit(-1);
+
+    double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+    std::cout << " # " << pvalue << " patrones (" << nvalue << " entradas, " << cvalue << " clases) escritos en " << ovalue
+    		<< " en " << segundos << " s" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+/*********************************************************************
+ * File  : grupoHilos.cpp
+ * Date  : 2016
+ *********************************************************************/
+
+#include <chrono>
+#include <algorithm>
+
+// Inclusión del archivo de cabecera del grupo de hilos
+#include "grupoHilos.hpp"
+
+// Tiempo (microsegundos) que un hilo sin tarea sigue esperando de forma activa antes de dormirse
+#define TIEMPO_ESPERA_ACTIVA 2000
+
+// ------------------------------
+// CONSTRUCTOR: grupo de nHilos hilos (el que lanza las tareas y nHilos-1 trabajadores)
+imc::GrupoHilos::GrupoHilos(const int &nHilos) {
+	this->nNumHilos = std::max(1, nHilos);
+	this->pTarea = NULL;
+	this->nGeneracion = 0;
+	this->nPendientes = 0;
+	this->bParar = false;
+	this->nDormidos = 0;
+	this->nLlegadosBarrera = 0;
+	this->bSentidoBarrera = false;
+
+	for(int k=1; k<this->nNumHilos; k++)
+		this->hilos.push_back(std::thread(&GrupoHilos::bucle, this, k));
+}
+
+// ------------------------------
+// DESTRUCTOR: detener los hilos trabajadores
+imc::GrupoHilos::~GrupoHilos() {
+	this->bParar = true;
+	this->nGeneracion++;
+	{
+		std::lock_guard<std::mutex> lock(this->cerrojo);
+		this->condicion.notify_all();
+	}
+	for(size_t k=0; k<this->hilos.size(); k++)
+		this->hilos[k].join();
+}
+
+// ------------------------------
+// Bucle de cada hilo trabajador (indice de 1 a nNumHilos-1)
+// Cada tarea se detecta por el cambio de generación; la espera es activa durante TIEMPO_ESPERA_ACTIVA
+// y después el hilo se duerme hasta que ejecutar() lo despierte
+void imc::GrupoHilos::bucle(const int &indice) {
+
+	unsigned int nVista = 0;
+	for(;;) {
+		std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+		for(int n=0; this->nGeneracion.load(std::memory_order_acquire) == nVista; n++) {
+			if (n < ESPERAS_ACTIVAS)
+				continue;
+			if (std::chrono::steady_clock::now() - inicio < std::chrono::microseconds(TIEMPO_ESPERA_ACTIVA)) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(this->cerrojo);
+			this->nDormidos++;
+			this->condicion.wait(lock, [&]{ return this->nGeneracion.load() != nVista; });
+			this->nDormidos--;
+		}
+		nVista = this->nGeneracion.load(std::memory_order_acquire);
+
+		if (this->bParar)
+			return;
+
+		(*this->pTarea)(indice);
+		this->nPendientes.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+// ------------------------------
+// Ejecutar tarea(k) para k = 0..nNumHilos-1 (el hilo que llama ejecuta k=0) y volver cuando terminen todos
+void imc::GrupoHilos::ejecutar(const std::function<void(const int &)> &tarea) {
+
+	if (this->nNumHilos == 1) {
+		tarea(0);
+		return;
+	}
+
+	this->pTarea = &tarea;
+	this->nPendientes.store(this->nNumHilos-1, std::memory_order_relaxed);
+	this->nGeneracion++;
+
+	// Solo se toma el cerrojo si algún trabajador se ha llegado a dormir
+	if (this->nDormidos > 0) {
+		std::lock_guard<std::mutex> lock(this->cerrojo);
+		this->condicion.notify_all();
+	}
+
+	tarea(0);
+	esperar([&]{ return this->nPendientes.load(std::memory_order_acquire) == 0; });
+}
+
+// ------------------------------
+// Esperar, dentro de una tarea, a que todos los hilos del grupo lleguen a la barrera
+// El último en llegar reinicia el contador e invierte el sentido, que es lo que esperan los demás
+void imc::GrupoHilos::barrera() {
+
+	if (this->nNumHilos == 1)
+		return;
+
+	bool bSentido = this->bSentidoBarrera.load(std::memory_order_acquire);
+	if (this->nLlegadosBarrera.fetch_add(1, std::memory_order_acq_rel) == this->nNumHilos-1) {
+		this->nLlegadosBarrera.store(0, std::memory_order_relaxed);
+		this->bSentidoBarrera.store(!bSentido, std::memory_order_release);
+	}else
+		esperar([&]{ return this->bSentidoBarrera.load(std::memory_order_acquire) != bSentido; });
+}
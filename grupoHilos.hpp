@@ -0,0 +1,76 @@
+/*********************************************************************
+ * File  : grupoHilos.hpp
+ * Date  : 2016
+ *********************************************************************/
+
+#ifndef _GRUPOHILOS_HPP_
+#define _GRUPOHILOS_HPP_
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Nº de comprobaciones de una espera activa antes de empezar a ceder el procesador
+#define ESPERAS_ACTIVAS 1024
+
+namespace imc {
+
+// Grupo persistente de hilos para repartir una tarea muy corta (por ejemplo, una capa de la red)
+// Los hilos se crean una sola vez y esperan la siguiente tarea de forma activa; si tarda en llegar,
+// ceden el procesador y, al final, se duermen para no consumir CPU mientras el servidor está parado
+// Las barreras entre fases de una misma tarea son también de espera activa
+class GrupoHilos {
+private:
+	int nNumHilos; /* Nº de hilos que ejecutan cada tarea (incluido el que la lanza) */
+	std::vector<std::thread> hilos;
+
+	const std::function<void(const int &)> * pTarea; /* Tarea en curso */
+	std::atomic<unsigned int> nGeneracion; /* Se incrementa al lanzar cada tarea */
+	std::atomic<int> nPendientes;          /* Hilos trabajadores que no han terminado la tarea en curso */
+	std::atomic<bool> bParar;
+
+	// Hilos dormidos a la espera de una tarea
+	std::mutex cerrojo;
+	std::condition_variable condicion;
+	std::atomic<int> nDormidos;
+
+	// Barrera de sentido alterno entre las fases de una tarea
+	std::atomic<int> nLlegadosBarrera;
+	std::atomic<bool> bSentidoBarrera;
+
+	// Bucle de cada hilo trabajador (indice de 1 a nNumHilos-1)
+	void bucle(const int &indice);
+
+public:
+
+	// CONSTRUCTOR: grupo de nHilos hilos (el que lanza las tareas y nHilos-1 trabajadores)
+	GrupoHilos(const int &nHilos);
+
+	// DESTRUCTOR: detener los hilos trabajadores
+	~GrupoHilos();
+
+	// Ejecutar tarea(k) para k = 0..nNumHilos-1 (el hilo que llama ejecuta k=0) y volver cuando terminen todos
+	void ejecutar(const std::function<void(const int &)> &tarea);
+
+	// Esperar, dentro de una tarea, a que todos los hilos del grupo lleguen a la barrera
+	void barrera();
+
+	// Esperar de forma activa a que se cumpla la condición, cediendo el procesador si tarda
+	template <typename Condicion>
+	static void esperar(const Condicion &condicion) {
+		for(int n=0; !condicion(); n++)
+			if (n >= ESPERAS_ACTIVAS)
+				std::this_thread::yield();
+	}
+
+	inline int getNumHilos() const {
+		return this->nNumHilos;
+	}
+};
+
+};
+
+#endif
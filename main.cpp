@@ -15,9 +15,36 @@
 #include <string.h>
 #include <math.h>
 #include <vector>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 // Inclusión de la clase PerceptrónMulticapa
 #include "perceptronMulticapa.hpp"
+#include "conjuntoRedes.hpp"
+#include "comunicador.hpp"
+#include "servidorInferencia.hpp"
+#include "redDispersa.hpp"
+
+// Medir el rendimiento (patrones por segundo) de una función que propaga nPatrones patrones,
+// repitiéndola hasta acumular al menos 0,2 segundos
+template<typename Funcion>
+static double medirRendimiento(const int &nPatrones, Funcion propagar) {
+
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+    long nRepeticiones = 0;
+    double segundos = 0.0;
+    do {
+    	propagar();
+    	nRepeticiones++;
+    	segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+    } while (segundos < 0.2);
+
+    return nRepeticiones * nPatrones / segundos;
+}
 
 int main(int argc, char **argv) {
 
@@ -58,12 +85,61 @@ int main(int argc, char **argv) {
     // o la función sigmoide en la capa de salida (false)
     bool svalue = false;
 
+    // Indica si se barajan los patrones de entrenamiento en cada época
+    bool rflag = false;
+
+    // Nº de particiones para la validación cruzada (0 => se usan los ficheros de entrenamiento y test)
+    int kvalue = 0;
+
+    // Indica si se evalúa el conjunto de las redes entrenadas con cada semilla
+    // y cómo se combinan sus salidas (Evalue=0 => media // Evalue=1 => votación)
+    bool Eflag = false;
+    int Evalue = 0;
+
+    // Nº de procesos entre los que se reparte el entrenamiento off-line
+    int wvalue = 1;
+
+    // Fichero en el que se guarda la red entrenada (la de mejor CCR de test entre las semillas)
+    char *gvalue = NULL;
+
+    // Fichero con una red guardada previamente
+    // (sin modo servidor, se continúa su entrenamiento con los patrones nuevos del fichero de entrenamiento)
+    char *cvalue = NULL;
+
+    // Poda de la red tras el entrenamiento: umbral de magnitud, proporción de pesos nulos por capa
+    // y nº de épocas de ajuste fino con los pesos podados fijos a cero
+    double Pvalue = 0.0;
+    double Dvalue = 0.0;
+    int Fvalue = 0;
+
+    // Indica si se entrena en el modo de memoria reducida (on-line, sin deltaW y con la copia de pesos en float16)
+    bool Lflag = false;
+
+    // Nº máximo de épocas que el entrenamiento se adelanta a la evaluación en segundo plano (0 => evaluación síncrona)
+    int Avalue = 0;
+
+    // Proporción de los patrones ya vistos que se mezclan con los nuevos en el entrenamiento incremental
+    double avalue = 0.0;
+
+    // Modo servidor: ruta del socket Unix en el que se atienden peticiones ("-" => entrada estándar)
+    char *Svalue = NULL;
+
+    // Nº máximo de patrones por lote y latencia máxima (microsegundos) para completar un lote en el servidor
+    int Bvalue = 64;
+    int uvalue = 1000;
+
+    // Nº de hilos entre los que el servidor reparte la propagación de cada lote
+    int Hvalue = 1;
+
+    // Nº de hilos entre los que se reparte cada pasada de evaluación (errores, CCR y matrices de confusión)
+    int jvalue = 1;
+
     // Variable para comprobar las opciones activadas
     int c;
 
     /* Procesamiento de la línea de comandos */
 
-    while ((c = getopt (argc, argv, "t:T:i:l:h:e:m:bof:s")) != -1) {
+    while ((c = getopt (argc, argv, "t:T:i:l:h:e:m:bof:srk:E:w:g:c:S:B:u:j:a:P:D:F:A:LH:")) != -1) {
     	switch(c) {
 
     	// Fichero con datos de entrenamiento
@@ -125,6 +201,93 @@ int main(int argc, char **argv) {
     		svalue = true;
     		break;
 
+    	// Barajar los patrones de entrenamiento en cada época
+    	case 'r':
+    		rflag = true;
+    		break;
+
+    	// Nº de particiones de la validación cruzada
+    	case 'k':
+    		kvalue = atoi(optarg);
+    		break;
+
+    	// Evaluación del conjunto de redes y forma de combinarlas
+    	// Evalue=0 => media de las salidas // Evalue=1 => votación por mayoría
+    	case 'E':
+    		Eflag = true;
+    		Evalue = atoi(optarg);
+    		break;
+
+    	// Nº de procesos del entrenamiento distribuido
+    	case 'w':
+    		wvalue = atoi(optarg);
+    		break;
+
+    	// Fichero en el que guardar la red entrenada
+    	case 'g':
+    		gvalue = optarg;
+    		break;
+
+    	// Fichero con una red guardada
+    	case 'c':
+    		cvalue = optarg;
+    		break;
+
+    	// Modo servidor
+    	case 'S':
+    		Svalue = optarg;
+    		break;
+
+    	// Tamaño máximo de lote del servidor
+    	case 'B':
+    		Bvalue = atoi(optarg);
+    		break;
+
+    	// Latencia máxima para completar un lote del servidor
+    	case 'u':
+    		uvalue = atoi(optarg);
+    		break;
+
+    	// Nº de hilos de la propagación en el servidor
+    	case 'H':
+    		Hvalue = atoi(optarg);
+    		break;
+
+    	// Nº de hilos de evaluación
+    	case 'j':
+    		jvalue = atoi(optarg);
+    		break;
+
+    	// Proporción de patrones ya vistos del entrenamiento incremental
+    	case 'a':
+    		avalue = atof(optarg);
+    		break;
+
+    	// Umbral de magnitud de la poda
+    	case 'P':
+    		Pvalue = atof(optarg);
+    		break;
+
+    	// Proporción de pesos podados por capa
+    	case 'D':
+    		Dvalue = atof(optarg);
+    		break;
+
+    	// Épocas de ajuste fino tras la poda
+    	case 'F':
+    		Fvalue = atoi(optarg);
+    		break;
+
+    	// Evaluación en segundo plano
+    	case 'A':
+    		Avalue = atoi(optarg);
+    		break;
+
+    	// Modo de memoria reducida
+    	case 'L':
+    		Lflag = true;
+    		break;
+
     	// Tratamiento de errores
     	case '?':
     		if (optopt == 'n' || optopt == 'u')
@@ -141,12 +304,111 @@ int main(int argc, char **argv) {
     	}
     }
 
+    // Modo servidor: se carga la red una sola vez y se atienden peticiones hasta que se detenga
+    if (Svalue != NULL) {
+    	if (cvalue == NULL) {
+    		std::cout << "\n # El modo servidor requiere una red guardada (argumento c)." << std::endl;
+    		exit(-1);
+    	}
+
+    	imc::PerceptronMulticapa mlpServidor;
+    	if (mlpServidor.cargarRed(cvalue) == EXIT_FAILURE)
+    		exit(-1);
+
+    	imc::ServidorInferencia servidor(mlpServidor,Bvalue,uvalue,Hvalue);
+    	if (strcmp(Svalue,"-") == 0)
+    		return servidor.servirEntradaEstandar();
+    	return servidor.servirSocket(Svalue);
+    }
+
     // Si no hay datos de entrenamiento no se puede continuar con el programa
     if (!tflag) {
     	std::cout << "\n # Se debe de especificar un fichero con datos de entrenamiento." << std::endl;
     	exit(-1);
     }
 
+    // La validación cruzada necesita al menos dos particiones
+    if (kvalue == 1 or kvalue < 0) {
+    	std::cout << "\n # El número de particiones de la validación cruzada debe ser mayor que 1." << std::endl;
+    	exit(-1);
+    }
+
+    // En validación cruzada las particiones de test se extraen de los datos de entrenamiento
+    if (kvalue > 1 and Tflag)
+    	std::cout << "\n # Validación cruzada activada, se ignorará el fichero de test." << std::endl;
+
+    // El conjunto de redes se forma con las redes de cada semilla, no de cada partición
+    if (kvalue > 1 and Eflag) {
+    	std::cout << "\n # El conjunto de redes no está disponible en validación cruzada, se ignorará." << std::endl;
+    	Eflag = false;
+    }
+
+    // En validación cruzada no hay una única red que guardar
+    if (kvalue > 1 and gvalue != NULL) {
+    	std::cout << "\n # En validación cruzada no se guarda ninguna red, se ignorará el fichero " << gvalue << "." << std::endl;
+    	gvalue = NULL;
+    }
+
+    // El entrenamiento distribuido suma los cambios de todos los procesos al final de cada época,
+    // por lo que solo tiene sentido en la versión off-line
+    if (wvalue < 1 or (wvalue > 1 and oflag)) {
+    	std::cout << "\n # El entrenamiento distribuido requiere la versión off-line y al menos 1 proceso." << std::endl;
+    	exit(-1);
+    }
+
+    // El modo de memoria reducida aplica cada cambio al calcularlo, así que solo admite la versión on-line
+    if (Lflag and !oflag) {
+    	std::cout << "\n # El modo de memoria reducida requiere la versión on-line (argumento o)." << std::endl;
+    	exit(-1);
+    }
+
+    // El entrenamiento incremental siempre evalúa cada época de forma síncrona
+    if (cvalue != NULL and Avalue > 0) {
+    	std::cout << "\n # En el entrenamiento incremental la evaluación es síncrona, se ignorará la evaluación en segundo plano." << std::endl;
+    	Avalue = 0;
+    }
+
+    // La evaluación en segundo plano necesita copias completas (double) de los pesos de cada época y una segunda red,
+    // justo lo que el modo de memoria reducida intenta evitar
+    if (Lflag and Avalue > 0) {
+    	std::cout << "\n # La evaluación en segundo plano (argumento A) no está disponible en el modo de memoria reducida." << std::endl;
+    	exit(-1);
+    }
+
+    if (wvalue > 1 and Avalue > 0) {
+    	std::cout << "\n # La evaluación en segundo plano no está disponible en el entrenamiento distribuido, se ignorará." << std::endl;
+    	Avalue = 0;
+    }
+
+    if (wvalue > 1 and kvalue > 1) {
+    	std::cout << "\n # El entrenamiento distribuido no está disponible en validación cruzada, se ignorará." << std::endl;
+    	wvalue = 1;
+    }
+
+    // El entrenamiento incremental continúa una única red, sin particiones, conjunto ni procesos
+    if (cvalue != NULL and (kvalue > 1 or Eflag or wvalue > 1)) {
+    	std::cout << "\n # En el entrenamiento incremental se ignoran la validación cruzada, el conjunto de redes y los procesos." << std::endl;
+    	kvalue = 0;
+    	Eflag = false;
+    	wvalue = 1;
+    }
+
+    if (avalue < 0.0 or avalue > 1.0) {
+    	std::cout << "\n # La proporción de patrones ya vistos debe estar entre 0 y 1." << std::endl;
+    	exit(-1);
+    }
+
+    // La poda se aplica a la red de cada semilla, por lo que no está disponible con particiones ni procesos
+    bool bPoda = (Pvalue > 0.0 or Dvalue > 0.0);
+    if (Dvalue < 0.0 or Dvalue >= 1.0 or Fvalue < 0) {
+    	std::cout << "\n # La proporción de pesos podados debe estar en [0,1) y las épocas de ajuste fino no pueden ser negativas." << std::endl;
+    	exit(-1);
+    }
+    if (bPoda and (kvalue > 1 or wvalue > 1 or cvalue != NULL)) {
+    	std::cout << "\n # La poda no está disponible en validación cruzada, entrenamiento distribuido ni incremental, se ignorará." << std::endl;
+    	bPoda = false;
+    }
+
     // Si no se especifican datos de test, se escogerán los de entrenamiento también para ello
     if (!Tflag) {
     	std::cout << "\n # Fichero con datos de test no especificado, se usarán los de entrenamiento." << std::endl;
@@ -169,6 +431,21 @@ int main(int argc, char **argv) {
     std::cout << " > Versión del algoritmo..........: " << ((oflag)?"On-line":"Off-line") << std::endl;
     std::cout << " > Función de error...............: " << ((fvalue)?"Entropía cruzada":"MSE") << std::endl;
     std::cout << " > Función en capa de salida......: " << ((svalue)?"Softmax":"Sigmoide") << std::endl;
+    std::cout << " > Barajar patrones...............: " << ((rflag)?"Activado":"Desactivado") << std::endl;
+    if (kvalue > 1)
+    	std::cout << " > Validación cruzada.............: " << kvalue << " particiones" << std::endl;
+    if (Eflag)
+    	std::cout << " > Conjunto de redes..............: " << ((Evalue)?"Votación":"Media") << std::endl;
+    if (wvalue > 1)
+    	std::cout << " > Procesos de entrenamiento......: " << wvalue << std::endl;
+    if (Lflag)
+    	std::cout << " > Memoria reducida...............: Activada" << std::endl;
+    if (Avalue > 0)
+    	std::cout << " > Evaluación en segundo plano....: hasta " << Avalue << " épocas de retraso" << std::endl;
+    if (bPoda)
+    	std::cout << " > Poda...........................: umbral " << Pvalue << ", dispersión " << 100*Dvalue << "%, " << Fvalue << " épocas de ajuste" << std::endl;
+    if (cvalue != NULL)
+    	std::cout << " > Red de partida (incremental)...: " << cvalue << " (" << 100*avalue << "% de patrones ya vistos)" << std::endl;
     std::cout << "***************************************************" << std::endl;
 
     // Declaración del perceptrón multicapa
@@ -177,6 +454,8 @@ int main(int argc, char **argv) {
     // Se proceden a leer los datos de entrenamiento y test de fichero
     imc::Datos * pDatosTrain = mlp.leerDatos(tvalue);
     imc::Datos * pDatosTest = mlp.leerDatos(Tvalue);
+    if (pDatosTrain == NULL or pDatosTest == NULL)
+    	exit(-1);
 
     // Se ajusta el uso o no de sesgo a la red neuronal
     mlp.setSesgo(bflag);
@@ -194,6 +473,87 @@ int main(int argc, char **argv) {
     // Se ajusta el uso del algoritmo on-line u off-line a la red neuronal
     mlp.setOnline(oflag);
 
+    // Se ajusta el barajado de los patrones de entrenamiento en cada época
+    mlp.setBarajar(rflag);
+
+    // Se ajusta el nº de hilos de cada pasada de evaluación
+    mlp.setHilosEvaluacion(jvalue);
+
+    // Se ajusta la evaluación en segundo plano de cada época
+    mlp.setRetrasoEvaluacion(Avalue);
+
+    // Se ajusta el modo de memoria reducida (antes de reservar la memoria de la red)
+    mlp.setAhorroMemoria(Lflag);
+
+    // Semilla de los números aleatorios
+    int semillas[] = {10,20,30,40,50};
+
+    /* Entrenamiento incremental: se continúa la red guardada solo con los patrones añadidos al fichero */
+
+    if (cvalue != NULL) {
+
+    	// La topología, el sesgo, la capa de salida y los momentos vienen del fichero de la red
+    	if (mlp.cargarRed(cvalue) == EXIT_FAILURE)
+    		exit(-1);
+    	if (mlp.getNumNeuronas(0) != pDatosTrain->nNumEntradas or mlp.getNumNeuronas(mlp.getNumCapas()-1) != pDatosTrain->nNumSalidas) {
+    		std::cout << "\n # La red " << cvalue << " no tiene las entradas y salidas de " << tvalue << "." << std::endl;
+    		exit(-1);
+    	}
+    	if (mlp.getPatronesVistos() > pDatosTrain->nNumPatrones) {
+    		std::cout << "\n # La red " << cvalue << " se entrenó con más patrones de los que tiene " << tvalue << "." << std::endl;
+    		exit(-1);
+    	}
+
+    	// Patrones nuevos (los añadidos al final del fichero) y una muestra de los ya vistos
+    	imc::Vista vistaIncremental;
+    	vistaIncremental.pDatos = pDatosTrain;
+    	for(int p=mlp.getPatronesVistos(); p<pDatosTrain->nNumPatrones; p++)
+    		vistaIncremental.indices.push_back(p);
+    	int nNuevos = vistaIncremental.indices.size();
+
+    	std::vector<int> vistos(mlp.getPatronesVistos());
+    	std::iota(vistos.begin(), vistos.end(), 0);
+    	std::mt19937 generador(semillas[0]);
+    	std::shuffle(vistos.begin(), vistos.end(), generador);
+    	vistos.resize((size_t) (avalue * vistos.size() + 0.5));
+    	vistaIncremental.indices.insert(vistaIncremental.indices.end(), vistos.begin(), vistos.end());
+
+    	if (nNuevos == 0) {
+    		std::cout << "\n # No hay patrones nuevos en " << tvalue << " desde el último entrenamiento de la red." << std::endl;
+    		return EXIT_SUCCESS;
+    	}
+
+    	mlp.setEta((oflag) ? evalue : evalue/vistaIncremental.indices.size());
+    	mlp.setSemilla(semillas[0]);
+
+    	std::cout << "\n*****************************" << std::endl;
+    	std::cout << " Entrenamiento incremental" << std::endl;
+    	std::cout << "*****************************" << std::endl;
+    	std::cout << " > Patrones nuevos......: " << nNuevos << std::endl;
+    	std::cout << " > Patrones ya vistos...: " << vistos.size() << " de " << mlp.getPatronesVistos() << std::endl;
+
+    	imc::Vista vistaTest = imc::crearVista(pDatosTest);
+    	double ccrInicial = mlp.evaluar(vistaTest,false).dCCR;
+
+    	double errorTrain, errorTest, ccrTrain, ccrTest;
+    	std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+    	int nEpocas = mlp.ejecutarIncremental(vistaIncremental,vistaTest,ivalue,errorTrain,errorTest,ccrTrain,ccrTest,fvalue);
+    	double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+
+    	std::cout << "\n > Épocas realizadas.....................: " << nEpocas << " (" << segundos << " segundos)" << std::endl;
+    	std::cout << " > Error de entrenamiento (incremental)..: " << errorTrain << std::endl;
+    	std::cout << " > Error de test.........................: " << errorTest << std::endl;
+    	std::cout << " > CCR de test (antes => después).......: " << ccrInicial << "% => " << ccrTest << "%" << std::endl;
+    	std::cout << " > Memoria de la red (parámetros + evaluación): " << (mlp.getMemoriaParametros() + mlp.getMemoriaEvaluacion()) / 1048576.0 << " MB" << std::endl;
+
+    	// A partir de ahora todos los patrones del fichero cuentan como vistos
+    	mlp.setPatronesVistos(pDatosTrain->nNumPatrones);
+    	if (gvalue != NULL and mlp.guardarRed(gvalue) == EXIT_SUCCESS)
+    		std::cout << " # Red guardada en " << gvalue << std::endl;
+
+    	return EXIT_SUCCESS;
+    }
+
     // Declaración e inicialización del vector topología
     // (Nº de neuronas por cada capa, incluyendo entrada y salida)
     std::vector<int> vTopologia(lvalue+2);
@@ -211,16 +571,16 @@ int main(int argc, char **argv) {
     // Inicialización propiamente dicha
     mlp.inicializar(vTopologia.size(),vTopologia,svalue);
 
-    // Semilla de los números aleatorios
-    int semillas[] = {10,20,30,40,50};
+    // Nº de ejecuciones realizadas (una por semilla, o una por partición y semilla en validación cruzada)
+    int nEjecuciones = (kvalue > 1) ? kvalue*5 : 5;
 
-    // Vectores con los errores medios de test y train en cada semilla
-    std::vector<double> erroresTest(5);
-    std::vector<double> erroresTrain(5);
+    // Vectores con los errores medios de test y train en cada ejecución
+    std::vector<double> erroresTest(nEjecuciones);
+    std::vector<double> erroresTrain(nEjecuciones);
 
-    // Vectores con el porcentaje de patrones de test y train bien clasificados en cada semilla
-    std::vector<double> ccrsTest(5);
-    std::vector<double> ccrsTrain(5);
+    // Vectores con el porcentaje de patrones de test y train bien clasificados en cada ejecución
+    std::vector<double> ccrsTest(nEjecuciones);
+    std::vector<double> ccrsTrain(nEjecuciones);
 
     // Media y desviación típica de los errores de test y train
     double mediaErrorTrain = 0.0, desviacionTipicaErrorTrain = 0.0;
@@ -230,18 +590,167 @@ int main(int argc, char **argv) {
     double mediaCCRTrain = 0.0, desviacionTipicaCCRTrain = 0.0;
     double mediaCCRTest = 0.0, desviacionTipicaCCRTest = 0.0;
 
-    for(int i=0; i<5; i++) {
+    // Conjunto con las redes entrenadas con cada semilla
+    imc::ConjuntoRedes conjunto;
 
-    	// Se muestra la semilla usada para generar los primeros pesos aleatorios de la red neuronal
-        srand(semillas[i]);
-    	std::cout << "\n**************" << std::endl;
-    	std::cout << " Semilla <" << semillas[i] << ">" << std::endl;
-    	std::cout << "**************" << std::endl;
+    // Memoria (bytes) de la red entrenada en cada ejecución: su bloque de parámetros más los vectores de trabajo de la evaluación
+    std::vector<size_t> memorias(nEjecuciones);
 
-    	// Se ejecuta el algoritmo y se obtienen los errores de train y test
-        mlp.ejecutarAlgoritmo(pDatosTrain,pDatosTest,ivalue,erroresTrain[i],erroresTest[i],ccrsTrain[i],ccrsTest[i],fvalue);
-    	std::cout << "\n # Finalizado => CCR de test final: " << ccrsTest[i] << std::endl;
-        //std::cout << "\n # Finalizado => Error de test final: " << erroresTest[i] << std::endl;
+    // Cada partición de la validación cruzada debe tener al menos un patrón
+    if (kvalue > pDatosTrain->nNumPatrones) {
+    	std::cout << "\n # El número de particiones (" << kvalue << ") no puede superar el de patrones de entrenamiento (" << pDatosTrain->nNumPatrones << ")." << std::endl;
+    	exit(-1);
+    }
+
+    if (kvalue > 1) {
+
+    	/* Validación cruzada: una red por partición y semilla, entrenadas en paralelo */
+
+    	// Se reparten los patrones entre las particiones tras barajarlos con la primera semilla
+    	// Las particiones son vistas sobre pDatosTrain, por lo que no se copia ningún dato
+    	std::vector<int> orden(pDatosTrain->nNumPatrones);
+    	std::iota(orden.begin(), orden.end(), 0);
+    	std::mt19937 generador(semillas[0]);
+    	std::shuffle(orden.begin(), orden.end(), generador);
+
+    	std::vector<imc::Vista> vistasTrain(kvalue), vistasTest(kvalue);
+    	for(int k=0; k<kvalue; k++) {
+    		vistasTrain[k].pDatos = pDatosTrain;
+    		vistasTest[k].pDatos = pDatosTrain;
+    	}
+    	for(int p=0; p<pDatosTrain->nNumPatrones; p++) {
+    		for(int k=0; k<kvalue; k++) {
+    			if (p % kvalue == k)
+    				vistasTest[k].indices.push_back(orden[p]);
+    			else
+    				vistasTrain[k].indices.push_back(orden[p]);
+    		}
+    	}
+
+    	// Cada hilo toma la siguiente ejecución pendiente hasta agotarlas
+    	std::atomic<int> siguienteEjecucion(0);
+    	int nHilos = std::max(1, std::min((int) std::thread::hardware_concurrency(), nEjecuciones));
+
+    	std::cout << "\n # Validación cruzada: " << nEjecuciones << " ejecuciones (" << kvalue << " particiones x 5 semillas) en " << nHilos << " hilos" << std::endl;
+
+    	std::vector<std::thread> hilos;
+    	for(int h=0; h<nHilos; h++) {
+    		hilos.push_back(std::thread([&]() {
+    			int e;
+    			while ((e = siguienteEjecucion++) < nEjecuciones) {
+    				int k = e / 5;
+
+    				// Cada ejecución usa su propia red, configurada igual que mlp
+    				imc::PerceptronMulticapa mlpParticion;
+    				mlpParticion.setSesgo(bflag);
+    				mlpParticion.setEta((oflag) ? evalue : evalue/vistasTrain[k].indices.size());
+    				mlpParticion.setMu(mvalue);
+    				mlpParticion.setOnline(oflag);
+    				mlpParticion.setBarajar(rflag);
+    				mlpParticion.setSilencioso(true);
+    				mlpParticion.setRetrasoEvaluacion(Avalue);
+    				mlpParticion.setAhorroMemoria(Lflag);
+    				mlpParticion.setSemilla(semillas[e % 5]);
+    				mlpParticion.inicializar(vTopologia.size(),vTopologia,svalue);
+
+    				mlpParticion.ejecutarAlgoritmo(vistasTrain[k],vistasTest[k],ivalue,erroresTrain[e],erroresTest[e],ccrsTrain[e],ccrsTest[e],fvalue);
+    				memorias[e] = mlpParticion.getMemoriaParametros() + mlpParticion.getMemoriaEvaluacion();
+    			}
+    		}));
+    	}
+    	for(size_t h=0; h<hilos.size(); h++)
+    		hilos[h].join();
+
+    	for(int e=0; e<nEjecuciones; e++)
+    		std::cout << " > Partición <" << e/5 + 1 << "> Semilla <" << semillas[e % 5] << "> => CCR de test: " << ccrsTest[e] << "%" << std::endl;
+
+    }else{
+
+    	// Entrenamiento distribuido: se crean los procesos trabajadores, que ejecutan el mismo bucle
+    	// de semillas con su parte de los patrones; solo el proceso principal muestra resultados
+    	imc::ComunicadorMemoriaCompartida comunicador;
+    	int rango = 0;
+    	if (wvalue > 1) {
+    		if (wvalue > pDatosTrain->nNumPatrones)
+    			wvalue = pDatosTrain->nNumPatrones;
+    		if (comunicador.inicializar(wvalue) == EXIT_FAILURE)
+    			exit(-1);
+
+    		std::cout.flush();
+    		rango = comunicador.lanzarProcesos();
+    		if (rango > 0 and freopen("/dev/null", "w", stdout) == NULL)
+    			exit(-1);
+    		mlp.setComunicador(&comunicador);
+    	}
+
+    	for(int i=0; i<5; i++) {
+
+    		// Se muestra la semilla usada para generar los primeros pesos aleatorios de la red neuronal
+    		mlp.setSemilla(semillas[i]);
+    		std::cout << "\n**************" << std::endl;
+    		std::cout << " Semilla <" << semillas[i] << ">" << std::endl;
+    		std::cout << "**************" << std::endl;
+
+    		// Se ejecuta el algoritmo y se obtienen los errores de train y test
+    		mlp.ejecutarAlgoritmo(pDatosTrain,pDatosTest,ivalue,erroresTrain[i],erroresTest[i],ccrsTrain[i],ccrsTest[i],fvalue);
+    		memorias[i] = mlp.getMemoriaParametros() + mlp.getMemoriaEvaluacion();
+    		std::cout << "\n # Finalizado => CCR de test final: " << ccrsTest[i] << std::endl;
+    		//std::cout << "\n # Finalizado => Error de test final: " << erroresTest[i] << std::endl;
+
+    		// Se poda la red y se compara con la red densa (CCR de test y patrones por segundo)
+    		// A partir de aquí, el conjunto y la red guardada usan la red podada
+    		if (bPoda) {
+    			imc::Vista vistaTest = imc::crearVista(pDatosTest);
+    			std::vector<double> entradasTest, salidasTest(pDatosTest->nNumPatrones * pDatosTest->nNumSalidas), trabajo;
+    			for(int p=0; p<pDatosTest->nNumPatrones; p++)
+    				entradasTest.insert(entradasTest.end(), pDatosTest->entradas[p].begin(), pDatosTest->entradas[p].end());
+
+    			double rendimientoDensa = medirRendimiento(pDatosTest->nNumPatrones, [&]() {
+    				mlp.propagarLote(entradasTest.data(), pDatosTest->nNumPatrones, salidasTest.data(), trabajo);
+    			});
+
+    			int nPodados = mlp.podar(Pvalue,Dvalue);
+    			for(int e=0; e<Fvalue; e++)
+    				mlp.entrenar(pDatosTrain,fvalue);
+    			double ccrAjustada = mlp.evaluar(vistaTest,false).dCCR;
+
+    			imc::RedDispersa redDispersa(mlp);
+    			double ccrDispersa = redDispersa.testClassification(vistaTest);
+    			double rendimientoDispersa = medirRendimiento(pDatosTest->nNumPatrones, [&]() {
+    				redDispersa.propagarLote(entradasTest.data(), pDatosTest->nNumPatrones, salidasTest.data(), trabajo);
+    			});
+
+    			std::cout << " # Poda: " << nPodados << " pesos podados, " << redDispersa.getNumPesosNoNulos() << " de " << redDispersa.getNumPesos()
+    					<< " no nulos (" << 100.0 * (1.0 - (double) redDispersa.getNumPesosNoNulos() / redDispersa.getNumPesos()) << "% de dispersión)" << std::endl;
+    			std::cout << " # CCR de test (densa => podada): " << ccrsTest[i] << "% => " << ccrDispersa << "%";
+    			if (ccrAjustada != ccrDispersa)
+    				std::cout << " (red densa podada: " << ccrAjustada << "%)";
+    			std::cout << std::endl;
+    			std::cout << " # Rendimiento (densa => CSR): " << rendimientoDensa << " => " << rendimientoDispersa << " patrones/s" << std::endl;
+    		}
+
+    		// Se conservan los pesos de la red entrenada para el conjunto
+    		if (Eflag and conjunto.agregarRed(mlp) == EXIT_FAILURE) {
+    			std::cout << "\n # La red de la semilla " << semillas[i] << " no tiene la topología de las demás redes del conjunto." << std::endl;
+    			exit(-1);
+    		}
+
+    		// Se guarda la red si es la de mejor CCR de test hasta el momento
+    		// Todos los patrones del fichero cuentan como vistos para un entrenamiento incremental posterior
+    		mlp.setPatronesVistos(pDatosTrain->nNumPatrones);
+    		if (gvalue != NULL and rango == 0 and (i == 0 or ccrsTest[i] > *std::max_element(ccrsTest.begin(), ccrsTest.begin()+i))) {
+    			if (mlp.guardarRed(gvalue) == EXIT_SUCCESS)
+    				std::cout << " # Red guardada en " << gvalue << std::endl;
+    		}
+    	}
+
+    	// Los procesos trabajadores terminan aquí; el principal espera por ellos
+    	if (rango > 0)
+    		exit(EXIT_SUCCESS);
+    	comunicador.esperarProcesos();
+    }
+
+    for(int i=0; i<nEjecuciones; i++) {
 
     	// Se calcula la media y desviación típica de los errores de train y test
     	mediaErrorTrain += erroresTrain[i];
@@ -257,16 +766,16 @@ int main(int argc, char **argv) {
     }
 
     // Se terminan de calcular la media y desviación típica de los errores
-    mediaErrorTrain /= 5;
-    mediaErrorTest /= 5;
-    desviacionTipicaErrorTrain = sqrt((desviacionTipicaErrorTrain/5) - pow(mediaErrorTrain,2));
-    desviacionTipicaErrorTest = sqrt((desviacionTipicaErrorTest/5) - pow(mediaErrorTest,2));
+    mediaErrorTrain /= nEjecuciones;
+    mediaErrorTest /= nEjecuciones;
+    desviacionTipicaErrorTrain = sqrt((desviacionTipicaErrorTrain/nEjecuciones) - pow(mediaErrorTrain,2));
+    desviacionTipicaErrorTest = sqrt((desviacionTipicaErrorTest/nEjecuciones) - pow(mediaErrorTest,2));
 
     // Se terminan de calcular la media y desviación típica de los CCRs
-    mediaCCRTrain /= 5;
-    mediaCCRTest /= 5;
-    desviacionTipicaCCRTrain = sqrt((desviacionTipicaCCRTrain/5) - pow(mediaCCRTrain,2));
-    desviacionTipicaCCRTest = sqrt((desviacionTipicaCCRTest/5) - pow(mediaCCRTest,2));
+    mediaCCRTrain /= nEjecuciones;
+    mediaCCRTest /= nEjecuciones;
+    desviacionTipicaCCRTrain = sqrt((desviacionTipicaCCRTrain/nEjecuciones) - pow(mediaCCRTrain,2));
+    desviacionTipicaCCRTest = sqrt((desviacionTipicaCCRTest/nEjecuciones) - pow(mediaCCRTest,2));
 
     // Se avisa por pantalla de la finalización de las semillas
     std::cout << "\n -> Todas las semillas han terminado. <-" << std::endl;
@@ -279,6 +788,14 @@ int main(int argc, char **argv) {
     std::cout << " > Error de test (Media +- DT): " << mediaErrorTest << " +- " << desviacionTipicaErrorTest << std::endl;
     std::cout << " > CCR de entrenamiento (Media +- DT): " << mediaCCRTrain << "% +- " << desviacionTipicaCCRTrain << std::endl;
     std::cout << " > CCR de test (Media +- DT): " << mediaCCRTest << "% +- " << desviacionTipicaCCRTest << std::endl;
+    std::cout << " > Memoria de la red (parámetros + evaluación): " << *std::max_element(memorias.begin(), memorias.end()) / 1048576.0 << " MB" << std::endl;
+
+    // Se evalúan todas las redes entrenadas a la vez como un único clasificador
+    if (Eflag) {
+    	std::cout << "\n # Conjunto de " << conjunto.getNumMiembros() << " redes - Matriz de confusión (test):" << std::endl;
+    	double ccrConjunto = conjunto.testClassification(imc::crearVista(pDatosTest),Evalue);
+    	std::cout << " > CCR de test del conjunto (" << ((Evalue)?"votación":"media") << "): " << ccrConjunto << "%" << std::endl;
+    }
 
     return EXIT_SUCCESS;
 }
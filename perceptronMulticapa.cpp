@@ -12,9 +12,123 @@
 #include <math.h>
 #include <vector>
 #include <time.h>
+#include <numeric>
+#include <random>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <charconv>
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 // Inclusión del archivo de cabecera de PerceptrónMulticapa
 #include "perceptronMulticapa.hpp"
+#include "canalizacionPatrones.hpp"
+#include "comunicador.hpp"
+#include "grupoHilos.hpp"
+
+// Nº de patrones por bloque en la canalización de entrenamiento
+#define TAM_BLOQUE_CANALIZACION 256
+
+// Nº de patrones por lote en cada pasada de evaluación
+#define TAM_LOTE_EVALUACION 256
+
+// Nº de épocas sin mejorar el error de entrenamiento tras las que se detiene el entrenamiento incremental
+#define PACIENCIA_INCREMENTAL 10
+
+// Tamaño mínimo (en bytes) del trozo de fichero de datos que lee cada hilo y nº máximo de líneas mal formadas que se muestran
+#define TAM_MIN_TROZO_DATOS (1 << 20)
+#define MAX_ERRORES_DATOS 10
+
+// Alineamiento (en bytes) del bloque de memoria de la red y de cada una de sus secciones
+#define ALINEAMIENTO_BLOQUE 64
+
+// Nº mínimo de multiplicaciones de una capa para repartirla entre varios hilos en la propagación paralela
+// y desequilibrio máximo (coste de la etapa más lenta frente al medio) para segmentar un lote por capas
+#define UMBRAL_CAPA_PARALELA 32768
+#define DESEQUILIBRIO_MAXIMO_ETAPAS 1.25
+
+// ------------------------------
+// Redondear un tamaño en bytes al siguiente múltiplo del alineamiento del bloque de memoria de la red
+static size_t alinearBloque(const size_t &tam) {
+	return ((tam + ALINEAMIENTO_BLOQUE - 1) / ALINEAMIENTO_BLOQUE) * ALINEAMIENTO_BLOQUE;
+}
+
+// ------------------------------
+// Convertir un valor a float16 (IEEE 754 binary16) con redondeo al par más cercano
+// Los valores fuera de rango se saturan al mayor float16 finito
+static uint16_t comprimirFloat16(const double &valor) {
+
+	float f = (float) valor;
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+
+	uint16_t signo = (x >> 16) & 0x8000;
+	int exponente = (int) ((x >> 23) & 0xff) - 127 + 15;
+	uint32_t mantisa = x & 0x7fffff;
+
+	if (((x >> 23) & 0xff) == 0xff)
+		return signo | (mantisa ? 0x7e00 : 0x7bff);
+
+	// Valores subnormales en float16 (o demasiado pequeños, que quedan a cero)
+	if (exponente <= 0) {
+		if (exponente < -10)
+			return signo;
+		mantisa |= 0x800000;
+		int desplazamiento = 14 - exponente;
+		uint32_t h = mantisa >> desplazamiento;
+		uint32_t resto = mantisa & ((1u << desplazamiento) - 1);
+		uint32_t mitad = 1u << (desplazamiento - 1);
+		if (resto > mitad or (resto == mitad and (h & 1)))
+			h++;
+		return signo | h;
+	}
+
+	if (exponente >= 31)
+		return signo | 0x7bff;
+
+	uint32_t h = ((uint32_t) exponente << 10) | (mantisa >> 13);
+	uint32_t resto = mantisa & 0x1fff;
+	if (resto > 0x1000 or (resto == 0x1000 and (h & 1)))
+		h++;
+	return signo | std::min<uint32_t>(h, 0x7bff);
+}
+
+// ------------------------------
+// Convertir un float16 (IEEE 754 binary16) a double
+static double expandirFloat16(const uint16_t &h) {
+
+	int exponente = (h >> 10) & 0x1f;
+	int mantisa = h & 0x3ff;
+
+	double valor;
+	if (exponente == 0)
+		valor = ldexp(mantisa, -24);
+	else if (exponente == 31)
+		valor = mantisa ? NAN : INFINITY;
+	else
+		valor = ldexp(mantisa + 1024, exponente - 25);
+
+	return (h & 0x8000) ? -valor : valor;
+}
+
+// ------------------------------
+// Avanzar hasta el primer carácter que no sea un espacio o un salto de línea (sin pasar de fin)
+static const char * saltarEspacios(const char * p, const char * fin) {
+	while (p < fin and (*p == ' ' or *p == '\t' or *p == '\r' or *p == '\n'))
+		p++;
+	return p;
+}
+
+// ------------------------------
+// Devolver el principio de la línea siguiente (o fin si no hay más líneas)
+static const char * siguienteLinea(const char * p, const char * fin) {
+	const char * salto = (const char *) memchr(p, '\n', fin - p);
+	return (salto == NULL) ? fin : salto + 1;
+}
 
 // ------------------------------
 // Obtener un número entero aleatorio en el intervalo [Low,High]
@@ -40,34 +154,114 @@ imc::PerceptronMulticapa::PerceptronMulticapa()
 	this->bSesgo = false;
 	this->nNumCapas = 3;
 	this->bOnline = false;
+	this->bBarajar = false;
+	this->bSilencioso = false;
+	this->nHilosEvaluacion = 1;
+	this->nNumPatronesVistos = 0;
+	this->nRetrasoEvaluacion = 0;
+	this->bAhorroMemoria = false;
+	this->pComunicador = NULL;
+	this->pBloque = NULL;
+	this->nTamBloque = 0;
+	this->nNumPesos = 0;
+	this->pPesos = this->pCambios = this->pUltimosCambios = this->pCopiaPesos = this->pSumatorios = NULL;
+	this->pCopiaComprimida = NULL;
+	this->pMascara = NULL;
+	this->bPodada = false;
+}
+
+// ------------------------------
+// Crear una vista que contiene todos los patrones de un conjunto de datos, en el orden del fichero
+imc::Vista imc::crearVista(Datos * pDatos) {
+
+	Vista vista;
+	vista.pDatos = pDatos;
+	vista.indices.resize(pDatos->nNumPatrones);
+	std::iota(vista.indices.begin(), vista.indices.end(), 0);
+
+	return vista;
 }
 
 // Reservar memoria para las estructuras de datos
 // nl tiene el numero de capas y npl es un vector que contiene el número de neuronas por cada una de las capas
 // Rellenar vector Capa* pCapas
+// Todas las neuronas, pesos, cambios, momentos, copias, sumatorios de trabajo y la máscara de la poda se sacan de un único
+// bloque alineado a 64 bytes, de forma que después de inicializar no se vuelve a reservar memoria
+// Fuera del bloque solo quedan los descriptores de las capas (pCapas, uno por capa), que no crecen con la anchura de la red
+// En el modo de memoria reducida no hay sección de cambios y la copia de los pesos se guarda en float16
 int imc::PerceptronMulticapa::inicializar(const int &nl, const std::vector<int> &npl, const bool &bSigmoideCapaSalida) {
 
 	// Se reserva espacio para el nº de capas de la red neuronal
 	this->nNumCapas = nl;
 	this->pCapas.resize(nl);
 
-	// Se reserva espacio para el nº de neuronas por capa
+	// Se calcula el tamaño del bloque a partir de la topología
+	size_t nNumNeuronasTotal = 0;
+	this->nNumPesos = 0;
+	for(int h=0; h<nl; h++) {
+		nNumNeuronasTotal += npl[h];
+		if (h > 0)
+			this->nNumPesos += (size_t) npl[h] * (npl[h-1] + this->bSesgo);
+	}
+
+	int nMaxNeuronas = *std::max_element(npl.begin(), npl.begin() + nl);
+
+	size_t tamNeuronas = alinearBloque(nNumNeuronasTotal * sizeof(Neurona));
+	size_t tamPesos = alinearBloque(this->nNumPesos * sizeof(double));
+	size_t tamCambios = this->bAhorroMemoria ? 0 : tamPesos;
+	size_t tamCopia = this->bAhorroMemoria ? alinearBloque(this->nNumPesos * sizeof(uint16_t)) : tamPesos;
+	size_t tamSumatorios = alinearBloque(nMaxNeuronas * sizeof(double));
+	size_t tamMascara = alinearBloque(this->nNumPesos * sizeof(unsigned char));
+	size_t tamTotal = tamNeuronas + 2 * tamPesos + tamCambios + tamCopia + tamSumatorios + tamMascara;
+
+	// Si la red ya tenía un bloque suficiente (por ejemplo, misma topología con otra semilla), se reutiliza
+	if (this->pBloque == NULL or tamTotal > this->nTamBloque) {
+		free(this->pBloque);
+		this->pBloque = (char *) aligned_alloc(ALINEAMIENTO_BLOQUE, tamTotal);
+		if (this->pBloque == NULL) {
+			this->nTamBloque = 0;
+			return EXIT_FAILURE;
+		}
+		this->nTamBloque = tamTotal;
+	}
+	memset(this->pBloque, 0, tamTotal);
+
+	// Secciones del bloque: neuronas, pesos (w), cambios (deltaW), últimos cambios (ultimoDeltaW), copias (wCopia)
+	// sumatorios de trabajo de la retropropagación y máscara de la poda
+	Neurona * pNeurona = (Neurona *) this->pBloque;
+	this->pPesos = (double *) (this->pBloque + tamNeuronas);
+	this->pCambios = this->bAhorroMemoria ? NULL : (double *) (this->pBloque + tamNeuronas + tamPesos);
+	this->pUltimosCambios = (double *) (this->pBloque + tamNeuronas + tamPesos + tamCambios);
+	this->pCopiaPesos = this->bAhorroMemoria ? NULL : (double *) (this->pBloque + tamNeuronas + 2*tamPesos + tamCambios);
+	this->pCopiaComprimida = this->bAhorroMemoria ? (uint16_t *) (this->pBloque + tamNeuronas + 2*tamPesos + tamCambios) : NULL;
+	this->pSumatorios = (double *) (this->pBloque + tamNeuronas + 2*tamPesos + tamCambios + tamCopia);
+	this->pMascara = (unsigned char *) (this->pBloque + tamNeuronas + 2*tamPesos + tamCambios + tamCopia + tamSumatorios);
+	this->bPodada = false;
+
+	// Desplazamiento de los pesos de la neurona actual dentro de cada sección
+	size_t desplazamiento = 0;
+
+	// Se reparte el bloque entre las neuronas de cada capa
 	for(int h=0; h<nl; h++) {
 		this->pCapas[h].nNumNeuronas = npl[h];
-		this->pCapas[h].pNeuronas.resize(npl[h]);
+		this->pCapas[h].pNeuronas = pNeurona;
+		pNeurona += npl[h];
 
 		// Por defecto en principio todas las neuronas de capas actúan como sigmoide
 		this->pCapas[h].tipo = 0;
 
-		// Se reserva espacio para las salidas y pesos en capa oculta y de salida
+		// Los pesos de una capa quedan contiguos, una fila por neurona
 		// (No es necesario en la capa de entrada)
-		if (h > 0) {
-			for(int j=0; j<npl[h]; j++) {
-				this->pCapas[h].pNeuronas[j].w.resize(npl[h-1] + this->bSesgo);
-				this->pCapas[h].pNeuronas[j].deltaW.resize(npl[h-1] + this->bSesgo);
-				this->pCapas[h].pNeuronas[j].ultimoDeltaW.resize(npl[h-1] + this->bSesgo);
-				this->pCapas[h].pNeuronas[j].wCopia.resize(npl[h-1] + this->bSesgo);
-			}
+		for(int j=0; j<npl[h]; j++) {
+			Neurona &neurona = this->pCapas[h].pNeuronas[j];
+			if (h > 0) {
+				neurona.w = this->pPesos + desplazamiento;
+				neurona.deltaW = this->bAhorroMemoria ? NULL : this->pCambios + desplazamiento;
+				neurona.ultimoDeltaW = this->pUltimosCambios + desplazamiento;
+				neurona.wCopia = this->bAhorroMemoria ? NULL : this->pCopiaPesos + desplazamiento;
+				desplazamiento += npl[h-1] + this->bSesgo;
+			}else
+				neurona.w = neurona.deltaW = neurona.ultimoDeltaW = neurona.wCopia = NULL;
 		}
 	}
 
@@ -78,6 +272,25 @@ int imc::PerceptronMulticapa::inicializar(const int &nl, const std::vector<int>
 	return EXIT_SUCCESS;
 }
 
+// ------------------------------
+// Reiniciar en su sitio el estado de la red (salidas, cambios, momentos, copias y poda), sin reservar memoria
+void imc::PerceptronMulticapa::reiniciar() {
+
+	for(int h=0; h<this->nNumCapas; h++)
+		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++)
+			this->pCapas[h].pNeuronas[j].x = this->pCapas[h].pNeuronas[j].dX = 0.0;
+
+	memset(this->pPesos, 0, this->nNumPesos * sizeof(double));
+	memset(this->pUltimosCambios, 0, this->nNumPesos * sizeof(double));
+	if (this->bAhorroMemoria)
+		memset(this->pCopiaComprimida, 0, this->nNumPesos * sizeof(uint16_t));
+	else {
+		memset(this->pCambios, 0, this->nNumPesos * sizeof(double));
+		memset(this->pCopiaPesos, 0, this->nNumPesos * sizeof(double));
+	}
+	this->bPodada = false;
+}
+
 
 // ------------------------------
 // DESTRUCTOR: liberar memoria
@@ -90,31 +303,52 @@ imc::PerceptronMulticapa::~PerceptronMulticapa() {
 // Liberar memoria para las estructuras de datos
 void imc::PerceptronMulticapa::liberarMemoria() {
 
-	for(int h=0; h<this->nNumCapas; h++) {
-		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++) {
-			this->pCapas[h].pNeuronas[j].w.clear();
-			this->pCapas[h].pNeuronas[j].deltaW.clear();
-			this->pCapas[h].pNeuronas[j].ultimoDeltaW.clear();
-			this->pCapas[h].pNeuronas[j].wCopia.clear();
-		}
-		this->pCapas[h].pNeuronas.clear();
-	}
+	free(this->pBloque);
+	this->pBloque = NULL;
+	this->nTamBloque = 0;
+	this->nNumPesos = 0;
+	this->pPesos = this->pCambios = this->pUltimosCambios = this->pCopiaPesos = this->pSumatorios = NULL;
+	this->pCopiaComprimida = NULL;
 	this->pCapas.clear();
+	this->nNumCapas = 0;
+}
+
+// ------------------------------
+// Imprimir una matriz de confusión (filas => clase deseada, columnas => clase obtenida)
+void imc::imprimirMatrizConfusion(const std::vector<std::vector<int> > &matrizConfusion) {
+
+	for(size_t i=0; i<matrizConfusion.size(); i++) {
+		std::cout << "|";
+		for(size_t j=0; j<matrizConfusion[i].size(); j++)
+			std::cout << " " << matrizConfusion[i][j];
+		std::cout << " |" << std::endl;
+	}
+}
+
+// ------------------------------
+// Copiar los pesos de la capa h (h>0) en destino, por filas: una fila de (nNumNeuronas(h-1) + bSesgo) pesos por neurona
+void imc::PerceptronMulticapa::copiarPesosCapa(const int &h, double * destino) const {
+
+	// Las filas de una capa son contiguas a partir de los pesos de su primera neurona
+	memcpy(destino, this->pCapas[h].pNeuronas[0].w, (size_t) this->pCapas[h].nNumNeuronas * (this->pCapas[h-1].nNumNeuronas + this->bSesgo) * sizeof(double));
 }
 
 // ------------------------------
 // Rellenar todos los pesos (w) aleatoriamente entre -1 y 1
 void imc::PerceptronMulticapa::pesosAleatorios() {
 
+	// Se usa el generador propio de la red para que varias redes puedan entrenarse a la vez
+	std::uniform_real_distribution<double> distribucion(-1.0,1.0);
+
 	for(int h=1; h<this->nNumCapas; h++)
 		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++)
 			for(int i=0; i<this->pCapas[h-1].nNumNeuronas + this->bSesgo; i++)
-				this->pCapas[h].pNeuronas[j].w[i] = realAleatorio(-1,1);
+				this->pCapas[h].pNeuronas[j].w[i] = distribucion(this->generador);
 }
 
 // ------------------------------
 // Alimentar las neuronas de entrada de la red con un patrón pasado como argumento
-void imc::PerceptronMulticapa::alimentarEntradas(const std::vector<double> &input) {
+void imc::PerceptronMulticapa::alimentarEntradas(const double * input) {
 
 	for(int j=0; j<pCapas[0].nNumNeuronas; j++)
 		this->pCapas[0].pNeuronas[j].x = input[j];
@@ -132,18 +366,30 @@ void imc::PerceptronMulticapa::recogerSalidas(std::vector<double> &output) {
 // Hacer una copia de todos los pesos (copiar w en copiaW)
 void imc::PerceptronMulticapa::copiarPesos() {
 
-	for(int h=0; h<this->nNumCapas; h++)
-		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++)
-			this->pCapas[h].pNeuronas[j].wCopia = this->pCapas[h].pNeuronas[j].w;
+	guardarCopia(this->pPesos);
+}
+
+// ------------------------------
+// Guardar un vector con todos los pesos como copia de la red (en float16 en el modo de memoria reducida)
+void imc::PerceptronMulticapa::guardarCopia(const double * pesos) {
+
+	// Los pesos de todas las capas son contiguos en el bloque de la red
+	if (this->bAhorroMemoria) {
+		for(size_t i=0; i<this->nNumPesos; i++)
+			this->pCopiaComprimida[i] = comprimirFloat16(pesos[i]);
+	}else
+		memcpy(this->pCopiaPesos, pesos, this->nNumPesos * sizeof(double));
 }
 
 // ------------------------------
 // Restaurar una copia de todos los pesos (copiar copiaW en w)
 void imc::PerceptronMulticapa::restaurarPesos() {
 
-	for(int h=0; h<this->nNumCapas; h++)
-		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++)
-			this->pCapas[h].pNeuronas[j].w = this->pCapas[h].pNeuronas[j].wCopia;
+	if (this->bAhorroMemoria) {
+		for(size_t i=0; i<this->nNumPesos; i++)
+			this->pPesos[i] = expandirFloat16(this->pCopiaComprimida[i]);
+	}else
+		memcpy(this->pPesos, this->pCopiaPesos, this->nNumPesos * sizeof(double));
 }
 
 // ------------------------------
@@ -189,21 +435,189 @@ void imc::PerceptronMulticapa::propagarEntradas() {
 }
 
 // ------------------------------
-// Calcular el error de salida del out de la capa de salida con respecto a un vector objetivo y devolverlo
+// Calcular las salidas de las neuronas jInicio..jFin-1 de la capa h para nPatrones patrones (por filas)
+// En una capa softmax deja exp(salida) sin normalizar
+void imc::PerceptronMulticapa::propagarCapa(const int &h, const double * entradaCapa, const int &nPatrones, double * salidaCapa, const int &jInicio, const int &jFin) const {
+
+	int nNumEntradas = this->pCapas[h-1].nNumNeuronas;
+	int nNumNeuronas = this->pCapas[h].nNumNeuronas;
+	int nNumColumnas = nNumEntradas + this->bSesgo;
+	bool bSoftmax = (h == this->nNumCapas-1 and this->pCapas[h].tipo == 1);
+
+	// Cada fila de pesos se aplica a todos los patrones del lote mientras está en caché
+	const double * w = this->pCapas[h].pNeuronas[0].w + (size_t) jInicio * nNumColumnas;
+	for(int j=jInicio; j<jFin; j++, w+=nNumColumnas) {
+		for(int p=0; p<nPatrones; p++) {
+			const double * x = entradaCapa + (size_t) p * nNumEntradas;
+			double salida = 0.0;
+			for(int i=0; i<nNumEntradas; i++)
+				salida += w[i] * x[i];
+
+			if (this->bSesgo)
+				salida += w[nNumEntradas];
+
+			salidaCapa[(size_t) p * nNumNeuronas + j] = bSoftmax ? exp(salida) : 1 / (1 + exp(-salida));
+		}
+	}
+}
+
+// ------------------------------
+// Normalizar por filas las salidas softmax de nPatrones patrones
+void imc::PerceptronMulticapa::normalizarSoftmax(double * salidas, const int &nPatrones) const {
+
+	int nNumNeuronas = this->pCapas[this->nNumCapas-1].nNumNeuronas;
+	for(int p=0; p<nPatrones; p++) {
+		double * fila = salidas + (size_t) p * nNumNeuronas;
+		double sumatorioSoftmax = 0.0;
+		for(int j=0; j<nNumNeuronas; j++)
+			sumatorioSoftmax += fila[j];
+		for(int j=0; j<nNumNeuronas; j++)
+			fila[j] /= sumatorioSoftmax;
+	}
+}
+
+// ------------------------------
+// Propagar un lote de nPatrones patrones (entradas por filas) y dejar las salidas de la red por filas en salidas
+// No modifica el estado de la red, así que varios hilos pueden usarlo a la vez con distintos vectores de trabajo
+void imc::PerceptronMulticapa::propagarLote(const double * entradas, const int &nPatrones, double * salidas, std::vector<double> &trabajo) const {
+
+	// Se usan dos mitades del vector de trabajo de forma alterna para las salidas de cada capa
+	int nMaxNeuronas = 0;
+	for(int h=1; h<this->nNumCapas-1; h++)
+		nMaxNeuronas = std::max(nMaxNeuronas, this->pCapas[h].nNumNeuronas);
+	trabajo.resize(2 * (size_t) nPatrones * nMaxNeuronas);
+
+	const double * entradaCapa = entradas;
+	for(int h=1; h<this->nNumCapas; h++) {
+		// La última capa escribe directamente en salidas
+		double * salidaCapa = (h == this->nNumCapas-1) ? salidas : &trabajo[(h % 2) * (size_t) nPatrones * nMaxNeuronas];
+
+		propagarCapa(h, entradaCapa, nPatrones, salidaCapa, 0, this->pCapas[h].nNumNeuronas);
+		entradaCapa = salidaCapa;
+	}
+
+	// Normalización de la función softmax para cada patrón
+	if (this->pCapas[this->nNumCapas-1].tipo == 1)
+		normalizarSoftmax(salidas, nPatrones);
+}
+
+// ------------------------------
+// Propagar un lote igual que propagarLote, repartiendo el trabajo entre los hilos del grupo (mismos resultados)
+// Un único patrón reparte las neuronas de cada capa grande entre los hilos, con una barrera entre capas;
+// un lote de varios patrones se segmenta por capas (cada hilo, una etapa) si las etapas quedan equilibradas
+void imc::PerceptronMulticapa::propagarLoteParalelo(const double * entradas, const int &nPatrones, double * salidas, std::vector<double> &trabajo, GrupoHilos &grupo) const {
+
+	int nHilos = grupo.getNumHilos();
+	int nCapasPesos = this->nNumCapas-1;
+
+	// Coste (multiplicaciones) de cada capa para el lote y coste total
+	std::vector<double> coste(this->nNumCapas, 0.0);
+	double costeTotal = 0.0, costeMaximo = 0.0;
+	for(int h=1; h<this->nNumCapas; h++) {
+		coste[h] = (double) nPatrones * this->pCapas[h].nNumNeuronas * (this->pCapas[h-1].nNumNeuronas + this->bSesgo);
+		costeTotal += coste[h];
+		costeMaximo = std::max(costeMaximo, coste[h]);
+	}
+
+	// Las redes pequeñas no compensan el reparto: se propagan en el hilo que llama
+	if (nHilos == 1 or costeMaximo < UMBRAL_CAPA_PARALELA) {
+		propagarLote(entradas, nPatrones, salidas, trabajo);
+		return;
+	}
+
+	// Cada capa oculta guarda sus salidas de todo el lote en su propia zona del vector de trabajo,
+	// porque en la segmentación varias capas se calculan a la vez con patrones distintos
+	std::vector<size_t> inicioCapa(this->nNumCapas, 0);
+	size_t nTamTrabajo = 0;
+	for(int h=1; h<this->nNumCapas-1; h++) {
+		inicioCapa[h] = nTamTrabajo;
+		nTamTrabajo += (size_t) nPatrones * this->pCapas[h].nNumNeuronas;
+	}
+	trabajo.resize(nTamTrabajo);
+	auto salidaCapa = [&](const int &h) {
+		return (h == this->nNumCapas-1) ? salidas : &trabajo[inicioCapa[h]];
+	};
+	auto entradaCapa = [&](const int &h) -> const double * {
+		return (h == 1) ? entradas : &trabajo[inicioCapa[h-1]];
+	};
+
+	// Reparto de las capas en etapas consecutivas de coste parecido (al menos una capa por etapa)
+	int nEtapas = std::min(nHilos, nCapasPesos);
+	std::vector<int> primeraCapa(nEtapas+1, this->nNumCapas);
+	primeraCapa[0] = 1;
+	double acumulado = 0.0, costeEtapa = 0.0, costeMaximoEtapa = 0.0;
+	for(int h=1, e=1; h<this->nNumCapas; h++) {
+		if (e < nEtapas and h > primeraCapa[e-1] and (acumulado + coste[h] / 2 > costeTotal * e / nEtapas or this->nNumCapas - h == nEtapas - e)) {
+			primeraCapa[e++] = h;
+			costeMaximoEtapa = std::max(costeMaximoEtapa, costeEtapa);
+			costeEtapa = 0.0;
+		}
+		acumulado += coste[h];
+		costeEtapa += coste[h];
+	}
+	costeMaximoEtapa = std::max(costeMaximoEtapa, costeEtapa);
+
+	if (nPatrones > 1 and nEtapas > 1 and costeMaximoEtapa <= DESEQUILIBRIO_MAXIMO_ETAPAS * costeTotal / nEtapas) {
+		// Segmentación por capas: el lote se divide en microlotes y la etapa k calcula sus capas para el
+		// microlote b en cuanto la etapa k-1 lo ha terminado, así que las etapas trabajan a la vez
+		int nMicrolotes = std::min(nPatrones, 4 * nEtapas);
+		std::vector<std::atomic<int> > progreso(nEtapas);
+		for(int e=0; e<nEtapas; e++)
+			progreso[e].store(0);
+
+		grupo.ejecutar([&](const int &k) {
+			if (k >= nEtapas)
+				return;
+			for(int b=0; b<nMicrolotes; b++) {
+				if (k > 0)
+					GrupoHilos::esperar([&]{ return progreso[k-1].load(std::memory_order_acquire) > b; });
+
+				int inicio = (int) ((long) nPatrones * b / nMicrolotes);
+				int fin = (int) ((long) nPatrones * (b+1) / nMicrolotes);
+				for(int h=primeraCapa[k]; h<primeraCapa[k+1]; h++)
+					propagarCapa(h, entradaCapa(h) + (size_t) inicio * this->pCapas[h-1].nNumNeuronas, fin - inicio,
+							salidaCapa(h) + (size_t) inicio * this->pCapas[h].nNumNeuronas, 0, this->pCapas[h].nNumNeuronas);
+
+				progreso[k].store(b+1, std::memory_order_release);
+			}
+		});
+	}else{
+		// Reparto de las neuronas de cada capa: el hilo k calcula su tramo de neuronas y todos esperan en
+		// la barrera antes de pasar a la capa siguiente; las capas pequeñas las calcula solo el hilo 0
+		grupo.ejecutar([&](const int &k) {
+			for(int h=1; h<this->nNumCapas; h++) {
+				int nNumNeuronas = this->pCapas[h].nNumNeuronas;
+				if (coste[h] >= UMBRAL_CAPA_PARALELA)
+					propagarCapa(h, entradaCapa(h), nPatrones, salidaCapa(h), (int) ((long) nNumNeuronas * k / nHilos), (int) ((long) nNumNeuronas * (k+1) / nHilos));
+				else if (k == 0)
+					propagarCapa(h, entradaCapa(h), nPatrones, salidaCapa(h), 0, nNumNeuronas);
+
+				if (h < this->nNumCapas-1)
+					grupo.barrera();
+			}
+		});
+	}
+
+	// Normalización de la función softmax para cada patrón
+	if (this->pCapas[this->nNumCapas-1].tipo == 1)
+		normalizarSoftmax(salidas, nPatrones);
+}
+
+// ------------------------------
+// Calcular el error de salida del out de la capa de salida con respecto a la clase deseada y devolverlo
 // funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
-double imc::PerceptronMulticapa::calcularErrorSalida(const std::vector<double> &target, const int &funcionError) {
+double imc::PerceptronMulticapa::calcularErrorSalida(const int &clase, const int &funcionError) {
 
 	// Variable con el error cometido (Entropía cruzada o MSE)
 	double error = 0.0;
 
-	// Función de error Entropía Cruzada
+	// Función de error Entropía Cruzada: solo la salida de la clase deseada tiene objetivo distinto de cero
 	if (funcionError) {
-		for(int j=0; j<this->pCapas[this->nNumCapas-1].nNumNeuronas; j++)
-			error -= target[j] * log(this->pCapas[this->nNumCapas-1].pNeuronas[j].x);
-	// Función de error MSE
+		error = -log(this->pCapas[this->nNumCapas-1].pNeuronas[clase].x);
+	// Función de error MSE (el objetivo de cada salida se obtiene de la clase)
 	}else{
 		for(int j=0; j<this->pCapas[this->nNumCapas-1].nNumNeuronas; j++)
-			error += pow(target[j] - this->pCapas[this->nNumCapas-1].pNeuronas[j].x,2);
+			error += pow(((j == clase) ? 1.0 : 0.0) - this->pCapas[this->nNumCapas-1].pNeuronas[j].x,2);
 	}
 
 	// Se ha de dividir dicho error calculado entre el número de neuronas de salida
@@ -211,61 +625,81 @@ double imc::PerceptronMulticapa::calcularErrorSalida(const std::vector<double> &
 }
 
 // ------------------------------
-// Retropropagar el error de salida con respecto a un vector pasado como argumento, desde la última capa hasta la primera
+// Retropropagar el error de salida con respecto a la clase deseada, desde la última capa hasta la primera
+// El objetivo de cada salida (1 para la clase deseada y 0 para el resto) se obtiene de la clase sin guardarlo
 // funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
-void imc::PerceptronMulticapa::retropropagarError(const std::vector<double> &objetivo, const int &funcionError) {
+void imc::PerceptronMulticapa::retropropagarError(const int &clase, const int &funcionError) {
+
+	Capa &salida = this->pCapas[this->nNumCapas-1];
 
 	// Si la última capa contiene neuronas con función Sigmoide...
-	if (this->pCapas[this->nNumCapas-1].tipo == 0) {
+	if (salida.tipo == 0) {
 		if (funcionError)
-			// Función de error Entropía Cruzada
-			for(int j=0; j<this->pCapas[this->nNumCapas-1].nNumNeuronas; j++)
-				this->pCapas[this->nNumCapas-1].pNeuronas[j].dX = -(objetivo[j] / this->pCapas[this->nNumCapas-1].pNeuronas[j].x) * this->pCapas[this->nNumCapas-1].pNeuronas[j].x * (1 - this->pCapas[this->nNumCapas-1].pNeuronas[j].x);
+			// Función de error Entropía Cruzada: solo la neurona de la clase deseada tiene derivada distinta de cero
+			for(int j=0; j<salida.nNumNeuronas; j++)
+				salida.pNeuronas[j].dX = (j == clase) ? -(1.0 / salida.pNeuronas[j].x) * salida.pNeuronas[j].x * (1 - salida.pNeuronas[j].x) : 0.0;
 		else
 			// Función de error MSE
-			for(int j=0; j<this->pCapas[this->nNumCapas-1].nNumNeuronas; j++)
-				this->pCapas[this->nNumCapas-1].pNeuronas[j].dX = -(objetivo[j] - this->pCapas[this->nNumCapas-1].pNeuronas[j].x) * this->pCapas[this->nNumCapas-1].pNeuronas[j].x * (1 - this->pCapas[this->nNumCapas-1].pNeuronas[j].x);
+			for(int j=0; j<salida.nNumNeuronas; j++)
+				salida.pNeuronas[j].dX = -(((j == clase) ? 1.0 : 0.0) - salida.pNeuronas[j].x) * salida.pNeuronas[j].x * (1 - salida.pNeuronas[j].x);
 	// Si la última capa contiene neuronas con función Softmax...
+	}else if (funcionError) {
+		// Función de error Entropía Cruzada: del sumatorio sobre las salidas solo queda el término de la clase deseada,
+		// así que la derivada de cada neurona se calcula en O(1)
+		double primerCalculo = 1.0 / salida.pNeuronas[clase].x;
+		for(int j=0; j<salida.nNumNeuronas; j++) {
+			double segundoCalculo;
+			if (j == clase)
+				segundoCalculo = salida.pNeuronas[j].x * (1 - salida.pNeuronas[clase].x);
+			else
+				segundoCalculo = salida.pNeuronas[j].x * (-salida.pNeuronas[clase].x);
+			salida.pNeuronas[j].dX = -(primerCalculo * segundoCalculo);
+		}
 	}else{
+		// Función de error MSE
 		// Sumatorio de las salidas softmax de todas las neuronas de la última capa
 		double sumatorioSoftmax = 0.0;
 
 		// Contienen las dos partes por separado de los cálculos necesarios
 		double primerCalculo, segundoCalculo;
 
-		for(int j=0; j<this->pCapas[this->nNumCapas-1].nNumNeuronas; j++) {
-			for(int i=0; i<this->pCapas[this->nNumCapas-1].nNumNeuronas; i++) {
-				// Función de error Entropía Cruzada
-				if (funcionError)
-					primerCalculo = objetivo[i] / this->pCapas[this->nNumCapas-1].pNeuronas[i].x;
-				// Función de error MSE
-				else
-					primerCalculo = objetivo[i] - this->pCapas[this->nNumCapas-1].pNeuronas[i].x;
+		for(int j=0; j<salida.nNumNeuronas; j++) {
+			for(int i=0; i<salida.nNumNeuronas; i++) {
+				primerCalculo = ((i == clase) ? 1.0 : 0.0) - salida.pNeuronas[i].x;
 
 				if (i == j)
-					segundoCalculo = this->pCapas[this->nNumCapas-1].pNeuronas[j].x * (1 - this->pCapas[this->nNumCapas-1].pNeuronas[i].x);
+					segundoCalculo = salida.pNeuronas[j].x * (1 - salida.pNeuronas[i].x);
 				else
-					segundoCalculo = this->pCapas[this->nNumCapas-1].pNeuronas[j].x * (-this->pCapas[this->nNumCapas-1].pNeuronas[i].x);
+					segundoCalculo = salida.pNeuronas[j].x * (-salida.pNeuronas[i].x);
 
 				sumatorioSoftmax -= primerCalculo * segundoCalculo;
 			}
-			this->pCapas[this->nNumCapas-1].pNeuronas[j].dX = sumatorioSoftmax;
+			salida.pNeuronas[j].dX = sumatorioSoftmax;
 			sumatorioSoftmax = 0.0;
 		}
 	}
 
-	// Contiene el sumatorio calculado para cada una de las neuronas
-	double sumatorio = 0.0;
-
 	// Se retropaga el error por las diferentes capas
+	// En lugar de recorrer la columna j de la matriz de pesos de la capa h+1 (un peso de cada fila),
+	// cada fila de pesos se recorre de forma contigua y se acumula en los sumatorios de todas las neuronas de la capa h
+	// Los sumatorios se acumulan en el mismo orden que antes, así que el resultado es idéntico
 	for(int h=this->nNumCapas-2; h>0; h--) {
-		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++) {
-			for(int i=0; i<this->pCapas[h+1].nNumNeuronas; i++)
-				sumatorio += this->pCapas[h+1].pNeuronas[i].w[j] * this->pCapas[h+1].pNeuronas[i].dX;
-
-			this->pCapas[h].pNeuronas[j].dX = sumatorio * this->pCapas[h].pNeuronas[j].x * (1 - this->pCapas[h].pNeuronas[j].x);
-			sumatorio = 0.0;
+		int nNumNeuronas = this->pCapas[h].nNumNeuronas;
+		int nNumColumnas = nNumNeuronas + this->bSesgo;
+		double * sumatorios = this->pSumatorios;
+
+		for(int j=0; j<nNumNeuronas; j++)
+			sumatorios[j] = 0.0;
+
+		const double * w = this->pCapas[h+1].pNeuronas[0].w;
+		for(int i=0; i<this->pCapas[h+1].nNumNeuronas; i++, w+=nNumColumnas) {
+			double dX = this->pCapas[h+1].pNeuronas[i].dX;
+			for(int j=0; j<nNumNeuronas; j++)
+				sumatorios[j] += w[j] * dX;
 		}
+
+		for(int j=0; j<nNumNeuronas; j++)
+			this->pCapas[h].pNeuronas[j].dX = sumatorios[j] * this->pCapas[h].pNeuronas[j].x * (1 - this->pCapas[h].pNeuronas[j].x);
 	}
 }
 
@@ -302,6 +736,195 @@ void imc::PerceptronMulticapa::ajustarPesos() {
 			}
 		}
 	}
+
+	if (this->bPodada)
+		aplicarMascara();
+}
+
+// ------------------------------
+// Calcular el cambio de cada peso con el patrón actual y aplicarlo en el mismo recorrido (on-line sin sección deltaW)
+// Las operaciones son las mismas que acumularCambio + ajustarPesos partiendo de deltaW a cero
+void imc::PerceptronMulticapa::ajustarPesosFusionado() {
+
+	for(int h=1; h<this->nNumCapas; h++) {
+		int nNumEntradas = this->pCapas[h-1].nNumNeuronas;
+		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++) {
+			double * w = this->pCapas[h].pNeuronas[j].w;
+			double * ultimoDeltaW = this->pCapas[h].pNeuronas[j].ultimoDeltaW;
+			double dX = this->pCapas[h].pNeuronas[j].dX;
+
+			for(int i=0; i<nNumEntradas; i++) {
+				double deltaW = dX * this->pCapas[h-1].pNeuronas[i].x;
+				w[i] += -(this->dEta * deltaW) - (this->dMu * (this->dEta * ultimoDeltaW[i]));
+				ultimoDeltaW[i] = deltaW;
+			}
+
+			if (this->bSesgo) {
+				w[nNumEntradas] += -(this->dEta * dX) - (this->dMu * (this->dEta * ultimoDeltaW[nNumEntradas]));
+				ultimoDeltaW[nNumEntradas] = dX;
+			}
+		}
+	}
+
+	if (this->bPodada)
+		aplicarMascara();
+}
+
+// ------------------------------
+// Mantener a cero los pesos podados (y sus momentos) después de cada ajuste
+void imc::PerceptronMulticapa::aplicarMascara() {
+
+	for(size_t i=0; i<this->nNumPesos; i++) {
+		if (!this->pMascara[i])
+			this->pPesos[i] = this->pUltimosCambios[i] = 0.0;
+	}
+}
+
+// ------------------------------
+// Podar por magnitud los pesos de cada capa (los sesgos no se podan): se ponen a cero los pesos con |w| < umbral
+// y, si dispersion > 0, los de menor magnitud hasta que esa proporción de los pesos de cada capa sea nula
+// Los pesos podados se mantienen a cero en los entrenamientos posteriores (ajuste fino)
+int imc::PerceptronMulticapa::podar(const double &umbral, const double &dispersion) {
+
+	// Una poda anterior se conserva: solo se pueden podar más pesos
+	if (!this->bPodada) {
+		memset(this->pMascara, 1, this->nNumPesos);
+		this->bPodada = true;
+	}
+
+	for(int h=1; h<this->nNumCapas; h++) {
+		int nNumEntradas = this->pCapas[h-1].nNumNeuronas;
+		int nNumColumnas = nNumEntradas + this->bSesgo;
+		size_t inicioCapa = this->pCapas[h].pNeuronas[0].w - this->pPesos;
+
+		// Posiciones (dentro de la sección de pesos) de los pesos de la capa que no son sesgos
+		std::vector<size_t> posiciones;
+		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++)
+			for(int i=0; i<nNumEntradas; i++)
+				posiciones.push_back(inicioCapa + (size_t) j * nNumColumnas + i);
+
+		for(size_t k=0; k<posiciones.size(); k++)
+			if (fabs(this->pPesos[posiciones[k]]) < umbral)
+				this->pMascara[posiciones[k]] = 0;
+
+		// Los pesos de menor magnitud de la capa se podan hasta alcanzar la dispersión pedida
+		size_t nObjetivo = (size_t) (dispersion * posiciones.size() + 0.5);
+		if (dispersion > 0 and nObjetivo > 0) {
+			std::nth_element(posiciones.begin(), posiciones.begin() + (nObjetivo - 1), posiciones.end(), [this](const size_t &a, const size_t &b) {
+				return fabs(this->pPesos[a]) < fabs(this->pPesos[b]);
+			});
+			for(size_t k=0; k<nObjetivo; k++)
+				this->pMascara[posiciones[k]] = 0;
+		}
+	}
+
+	aplicarMascara();
+
+	int nPodados = 0;
+	for(size_t i=0; i<this->nNumPesos; i++)
+		nPodados += !this->pMascara[i];
+	return nPodados;
+}
+
+// ------------------------------
+// Sumar los deltaW acumulados por todos los procesos del entrenamiento distribuido
+void imc::PerceptronMulticapa::sumarCambiosDistribuidos() {
+
+	// Los cambios de todas las capas son contiguos en el bloque, así que se suman en una sola llamada
+	this->pComunicador->sumarTodos(this->pCambios, this->nNumPesos);
+}
+
+// ------------------------------
+// Bucle de entrenamiento con la evaluación de cada época en un hilo de fondo, sobre una copia de los pesos
+// El entrenamiento no se adelanta más de nRetrasoEvaluacion épocas a la última época evaluada
+// Cada copia se evalúa con los patrones de entrenamiento y de test; los resultados de cada época se dejan en historial
+double imc::PerceptronMulticapa::entrenarEvaluacionAsincrona(const Vista &vistaTrain, const Vista &vistaTest, CanalizacionPatrones * pCanalizacion, const int &maxiter, const int &funcionError, std::vector<EvaluacionEpoca> &historial) {
+
+	// Red con la misma topología sobre la que el hilo de fondo evalúa cada copia de pesos
+	PerceptronMulticapa evaluador;
+	std::vector<int> npl(this->nNumCapas);
+	for(int h=0; h<this->nNumCapas; h++)
+		npl[h] = this->pCapas[h].nNumNeuronas;
+	evaluador.setSesgo(this->bSesgo);
+	evaluador.setAhorroMemoria(this->bAhorroMemoria);
+	evaluador.inicializar(this->nNumCapas, npl, isSoftmax());
+	evaluador.setHilosEvaluacion(this->nHilosEvaluacion);
+
+	// Copias de pesos pendientes de evaluar (época, pesos) y estado compartido con el hilo de fondo
+	std::deque<std::pair<int, std::vector<double> > > pendientes;
+	std::mutex cerrojo;
+	std::condition_variable condicion;
+	int nEnviadas = 0, nEvaluadas = 0;
+	bool bFin = false, bParar = false;
+
+	double minTrainError = 0.0;
+	int numSinMejorar = 0;
+
+	// Hilo evaluador: decide la parada y la mejor copia con los resultados en el orden de las épocas
+	std::thread hiloEvaluador([&]() {
+		std::unique_lock<std::mutex> bloqueo(cerrojo);
+		while (true) {
+			condicion.wait(bloqueo, [&]() { return !pendientes.empty() or bFin; });
+			if (pendientes.empty() or bParar)
+				break;
+			std::pair<int, std::vector<double> > copia = std::move(pendientes.front());
+			pendientes.pop_front();
+			bloqueo.unlock();
+
+			memcpy(evaluador.pPesos, copia.second.data(), this->nNumPesos * sizeof(double));
+			Evaluacion evaluacionTrain = evaluador.evaluar(vistaTrain,false);
+			Evaluacion evaluacionTest = evaluador.evaluar(vistaTest,false);
+			double trainError = evaluacionTrain.error(funcionError);
+			historial.push_back({copia.first + 1, trainError, evaluacionTest.error(funcionError), evaluacionTrain.dCCR, evaluacionTest.dCCR});
+
+			// Mismo criterio que la evaluación síncrona; la mejor copia son los pesos evaluados, no los actuales
+			if (copia.first == 0 or fabs(trainError - minTrainError) > 0.00001) {
+				minTrainError = trainError;
+				guardarCopia(copia.second.data());
+				numSinMejorar = 0;
+			}else
+				numSinMejorar++;
+
+			if (!this->bSilencioso)
+				std::cout << "Iteración " << copia.first + 1 << "\t Error de entrenamiento: " << trainError << "\t Error de test: " << historial.back().dErrorTest
+						<< "\t CCR de entrenamiento: " << evaluacionTrain.dCCR << "%\t CCR de test: " << evaluacionTest.dCCR << "%" << std::endl;
+
+			bloqueo.lock();
+			nEvaluadas++;
+			if (numSinMejorar == 50)
+				bParar = true;
+			condicion.notify_all();
+		}
+	});
+
+	for(int countTrain=0; countTrain<maxiter; countTrain++) {
+
+		if (pCanalizacion != NULL)
+			entrenar(*pCanalizacion,funcionError);
+		else
+			entrenar(vistaTrain,funcionError);
+
+		// Se entrega una copia de los pesos de la época y se sigue entrenando,
+		// salvo que el evaluador vaya más de nRetrasoEvaluacion épocas por detrás
+		std::vector<double> pesos(this->pPesos, this->pPesos + this->nNumPesos);
+		std::unique_lock<std::mutex> bloqueo(cerrojo);
+		pendientes.push_back(std::make_pair(countTrain, std::move(pesos)));
+		nEnviadas++;
+		condicion.notify_all();
+		condicion.wait(bloqueo, [&]() { return nEnviadas - nEvaluadas <= this->nRetrasoEvaluacion or bParar; });
+		if (bParar)
+			break;
+	}
+
+	// Se evalúan las épocas pendientes (salvo que ya se haya decidido parar) y termina el hilo evaluador
+	{
+		std::lock_guard<std::mutex> bloqueo(cerrojo);
+		bFin = true;
+		condicion.notify_all();
+	}
+	hiloEvaluador.join();
+
+	return minTrainError;
 }
 
 // ------------------------------
@@ -329,16 +952,23 @@ void imc::PerceptronMulticapa::imprimirRed() {
 
 // ------------------------------
 // Simular la red: propagar las entradas hacia delante, retropropagar el error y ajustar los pesos
-// entrada es el vector de entradas del patrón y objetivo es el vector de salidas deseadas del patrón
+// entrada es el vector de entradas del patrón y clase es la clase deseada del patrón
 // El paso de ajustar pesos solo deberá hacerse si el algoritmo es on-line
 // Si no lo es, el ajuste de pesos hay que hacerlo en la función "entrenar"
 // funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
-void imc::PerceptronMulticapa::simularRed(const std::vector<double> &entrada, const std::vector<double> &objetivo, const int &funcionError) {
+void imc::PerceptronMulticapa::simularRed(const double * entrada, const int &clase, const int &funcionError) {
 
 	// Se realizan los diferentes pasos para la simulación de la red neuronal
 	alimentarEntradas(entrada);
 	propagarEntradas();
-	retropropagarError(objetivo,funcionError);
+	retropropagarError(clase,funcionError);
+
+	// En el modo de memoria reducida (siempre on-line) cada cambio se aplica directamente al peso, sin pasar por deltaW
+	if (this->bAhorroMemoria) {
+		ajustarPesosFusionado();
+		return;
+	}
+
 	acumularCambio();
 
 	// Sólo se ajustan los pesos para cada patrón en el algoritmo On-line
@@ -347,55 +977,302 @@ void imc::PerceptronMulticapa::simularRed(const std::vector<double> &entrada, co
 		ajustarPesos();
 
 		// Se establecen los valores de delta a 0
-		for(int h=1; h<this->nNumCapas; h++) {
-			for(int j=0; j<this->pCapas[h].nNumNeuronas; j++) {
-				for(int i=0; i<this->pCapas[h-1].nNumNeuronas; i++)
-					this->pCapas[h].pNeuronas[j].deltaW[i] = 0.0;
-
-				if (this->bSesgo)
-					this->pCapas[h].pNeuronas[j].deltaW[this->pCapas[h-1].nNumNeuronas] = 0.0;
-			}
-		}
+		memset(this->pCambios, 0, this->nNumPesos * sizeof(double));
 	}
 }
 
 // ------------------------------
 // Leer una matriz de datos a partir de un nombre de fichero y devolverla
+// El fichero se lee de una vez y se reparte por líneas entre varios hilos (un patrón por línea)
+// Devuelve NULL, tras informar de la cabecera o de las líneas mal formadas, si el fichero no es válido
 imc::Datos* imc::PerceptronMulticapa::leerDatos(const char * archivo) {
 
-	// Estructura con los datos leídos que se devuelve
+	// Se lee el fichero de texto completo de una vez
+	std::ifstream f(archivo, std::ios::binary | std::ios::ate);
+	if (!f) {
+		std::cerr << "\n # No se pudo abrir el fichero de datos " << archivo << "." << std::endl;
+		return NULL;
+	}
+	std::vector<char> texto((size_t) f.tellg());
+	f.seekg(0);
+	f.read(texto.data(), texto.size());
+	f.close();
+
+	const char * inicio = texto.data();
+	const char * fin = inicio + texto.size();
+
+	// Cabecera: nº de entradas, salidas y patrones en la primera línea
+	int cabecera[3];
+	const char * p = inicio;
+	const char * finCabecera = siguienteLinea(inicio, fin);
+	for(int k=0; k<3; k++) {
+		p = saltarEspacios(p, finCabecera);
+		std::from_chars_result r = std::from_chars(p, finCabecera, cabecera[k]);
+		if (r.ec != std::errc() or cabecera[k] <= 0) {
+			std::cerr << "\n # Cabecera incorrecta en el fichero de datos " << archivo << " (se esperan nº de entradas, salidas y patrones)." << std::endl;
+			return NULL;
+		}
+		p = r.ptr;
+	}
+	if (saltarEspacios(p, finCabecera) != finCabecera) {
+		std::cerr << "\n # Cabecera incorrecta en el fichero de datos " << archivo << " (valores de más en la línea 1)." << std::endl;
+		return NULL;
+	}
+
+	// Estructura con los datos leídos que se devuelve (las filas se reservan cuando se sabe que el nº de patrones es correcto)
 	imc::Datos * pDatos = new imc::Datos;
+	pDatos->nNumEntradas = cabecera[0];
+	pDatos->nNumSalidas = cabecera[1];
+	pDatos->nNumPatrones = cabecera[2];
+
+	// El resto del fichero se divide en trozos que empiezan a principio de línea, uno por hilo
+	const char * cuerpo = finCabecera;
+	int nHilos = std::max(1, (int) std::min<size_t>(std::thread::hardware_concurrency(), (fin - cuerpo) / TAM_MIN_TROZO_DATOS + 1));
+	std::vector<const char *> trozos(nHilos + 1);
+	trozos[0] = cuerpo;
+	trozos[nHilos] = fin;
+	for(int t=1; t<nHilos; t++)
+		trozos[t] = std::max(trozos[t-1], siguienteLinea(cuerpo + (fin - cuerpo) * t / nHilos - 1, fin));
+
+	// Primera pasada: líneas totales y líneas con patrón (no vacías) de cada trozo,
+	// para saber en qué patrón y en qué línea del fichero empieza cada trozo
+	std::vector<long> nLineas(nHilos + 1, 0), nPatrones(nHilos + 1, 0);
+	std::vector<std::thread> hilos;
+	for(int t=0; t<nHilos; t++) {
+		hilos.push_back(std::thread([&, t]() {
+			for(const char * linea=trozos[t]; linea<trozos[t+1]; ) {
+				const char * siguiente = siguienteLinea(linea, trozos[t+1]);
+				nLineas[t+1]++;
+				if (saltarEspacios(linea, siguiente) != siguiente)
+					nPatrones[t+1]++;
+				linea = siguiente;
+			}
+		}));
+	}
+	for(int t=0; t<nHilos; t++)
+		hilos[t].join();
+	hilos.clear();
+
+	for(int t=1; t<=nHilos; t++) {
+		nLineas[t] += nLineas[t-1];
+		nPatrones[t] += nPatrones[t-1];
+	}
+
+	if (nPatrones[nHilos] != pDatos->nNumPatrones) {
+		std::cerr << "\n # El fichero de datos " << archivo << " contiene " << nPatrones[nHilos] << " patrones, pero la cabecera indica " << pDatos->nNumPatrones << "." << std::endl;
+		delete pDatos;
+		return NULL;
+	}
+
+	// Todas las filas se reservan aquí, antes de lanzar los hilos, para que no compitan en el reservador de memoria
+	pDatos->entradas.assign(pDatos->nNumPatrones, std::vector<double>(pDatos->nNumEntradas));
+	pDatos->clases.resize(pDatos->nNumPatrones);
+
+	// Segunda pasada: cada hilo lee sus patrones directamente en las filas de pDatos
+	// y anota las líneas mal formadas (nº de línea del fichero y motivo)
+	std::vector<std::vector<std::pair<long, std::string> > > errores(nHilos);
+	for(int t=0; t<nHilos; t++) {
+		hilos.push_back(std::thread([&, t]() {
+			long nLinea = nLineas[t] + 2;
+			long i = nPatrones[t];
+			std::vector<double> salidas(pDatos->nNumSalidas);
+			for(const char * linea=trozos[t]; linea<trozos[t+1]; nLinea++) {
+				const char * siguiente = siguienteLinea(linea, trozos[t+1]);
+				const char * q = saltarEspacios(linea, siguiente);
+				if (q == siguiente) {
+					linea = siguiente;
+					continue;
+				}
+
+				int nValores = pDatos->nNumEntradas + pDatos->nNumSalidas;
+				int j = 0;
+				for(; j<nValores and q<siguiente; j++) {
+					double &valor = (j < pDatos->nNumEntradas) ? pDatos->entradas[i][j] : salidas[j - pDatos->nNumEntradas];
+					if (*q == '+')
+						q++;
+					std::from_chars_result r = std::from_chars(q, siguiente, valor);
+					if (r.ec != std::errc() or (r.ptr < siguiente and !isspace((unsigned char) *r.ptr))) {
+						errores[t].push_back(std::make_pair(nLinea, "valor " + std::to_string(j+1) + " no numérico"));
+						break;
+					}
+					q = saltarEspacios(r.ptr, siguiente);
+				}
+
+				if (errores[t].empty() or errores[t].back().first != nLinea) {
+					if (j < nValores)
+						errores[t].push_back(std::make_pair(nLinea, std::to_string(j) + " valores de " + std::to_string(nValores)));
+					else if (q != siguiente)
+						errores[t].push_back(std::make_pair(nLinea, "más de " + std::to_string(nValores) + " valores"));
+				}
+
+				// Las salidas se guardan como el índice de la única que vale 1
+				if (errores[t].empty() or errores[t].back().first != nLinea) {
+					int nUnos = 0, nCeros = 0;
+					for(int k=0; k<pDatos->nNumSalidas; k++) {
+						if (salidas[k] == 1) {
+							pDatos->clases[i] = k;
+							nUnos++;
+						}else if (salidas[k] == 0)
+							nCeros++;
+					}
+					if (nUnos != 1 or nCeros != pDatos->nNumSalidas - 1)
+						errores[t].push_back(std::make_pair(nLinea, "salidas sin codificación 1 de n"));
+				}
+
+				i++;
+				linea = siguiente;
+			}
+		}));
+	}
+	for(int t=0; t<nHilos; t++)
+		hilos[t].join();
+
+	// Se informa de las primeras líneas mal formadas (los hilos las dejan ya ordenadas por línea)
+	long nErrores = 0;
+	for(int t=0; t<nHilos; t++) {
+		for(size_t e=0; e<errores[t].size(); e++, nErrores++)
+			if (nErrores < MAX_ERRORES_DATOS)
+				std::cerr << " # " << archivo << ":" << errores[t][e].first << ": " << errores[t][e].second << std::endl;
+	}
+	if (nErrores > 0) {
+		std::cerr << "\n # El fichero de datos " << archivo << " tiene " << nErrores << " líneas mal formadas." << std::endl;
+		delete pDatos;
+		return NULL;
+	}
+
+	return pDatos;
+}
+
+// ------------------------------
+// Guardar la topología, los pesos, el estado del optimizador (últimos cambios y patrones vistos) y, si la red está podada,
+// la máscara de la poda en un fichero de texto
+// Formato: "nNumCapas sesgo tipoSalida", una línea con el nº de neuronas por capa y una línea de pesos por neurona
+int imc::PerceptronMulticapa::guardarRed(const char * archivo) const {
+
+	std::ofstream f(archivo);
+	if (!f) {
+		std::cerr << "\n # No se pudo abrir el fichero " << archivo << " para guardar la red." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// Se escriben los pesos con todos los decimales para recuperarlos exactamente
+	f.precision(std::numeric_limits<double>::max_digits10);
+
+	f << this->nNumCapas << " " << this->bSesgo << " " << this->pCapas[this->nNumCapas-1].tipo << std::endl;
+	for(int h=0; h<this->nNumCapas; h++)
+		f << this->pCapas[h].nNumNeuronas << ((h == this->nNumCapas-1) ? "\n" : " ");
+
+	for(int h=1; h<this->nNumCapas; h++) {
+		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++) {
+			for(int i=0; i<this->pCapas[h-1].nNumNeuronas + this->bSesgo; i++)
+				f << this->pCapas[h].pNeuronas[j].w[i] << " ";
+			f << std::endl;
+		}
+	}
+
+	// Estado del optimizador para poder continuar el entrenamiento: patrones vistos y últimos cambios (momentos)
+	f << "estado " << this->nNumPatronesVistos << std::endl;
+	for(int h=1; h<this->nNumCapas; h++) {
+		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++) {
+			for(int i=0; i<this->pCapas[h-1].nNumNeuronas + this->bSesgo; i++)
+				f << this->pCapas[h].pNeuronas[j].ultimoDeltaW[i] << " ";
+			f << std::endl;
+		}
+	}
+
+	// Máscara de la poda, si la hay: nº de pesos podados y sus posiciones dentro de la sección de pesos
+	if (this->bPodada) {
+		f << "mascara " << std::count(this->pMascara, this->pMascara + this->nNumPesos, 0) << std::endl;
+		for(size_t i=0; i<this->nNumPesos; i++)
+			if (!this->pMascara[i])
+				f << i << " ";
+		f << std::endl;
+	}
+
+	return f.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ------------------------------
+// Cargar una red guardada con guardarRed, reservando la memoria para su topología
+// El estado del optimizador es opcional: si el fichero no lo incluye, los momentos empiezan a cero
+// La máscara de la poda también: sin ella, la red se carga sin podar
+int imc::PerceptronMulticapa::cargarRed(const char * archivo) {
 
-	// Se abre el fichero de texto
 	std::ifstream f(archivo);
+	if (!f) {
+		std::cerr << "\n # No se pudo abrir el fichero " << archivo << " para cargar la red." << std::endl;
+		return EXIT_FAILURE;
+	}
 
-	// Se lee el nº de entradas, salidas y patrones de la red neuronal
-	f >> pDatos->nNumEntradas >> pDatos->nNumSalidas >> pDatos->nNumPatrones;
+	int nl = 0, tipoSalida = 0;
+	bool sesgo = false;
+	f >> nl >> sesgo >> tipoSalida;
+	if (!f or nl < 2) {
+		std::cerr << "\n # Cabecera de red incorrecta en " << archivo << "." << std::endl;
+		return EXIT_FAILURE;
+	}
 
-	// Se reserva memoria para las matrices de entrada y salida
-	pDatos->entradas.resize(pDatos->nNumPatrones);
-	pDatos->salidas.resize(pDatos->nNumPatrones);
+	std::vector<int> npl(nl);
+	for(int h=0; h<nl; h++)
+		f >> npl[h];
 
-	for(int i=0; i<pDatos->nNumPatrones; i++) {
-		pDatos->entradas[i].resize(pDatos->nNumEntradas);
-		pDatos->salidas[i].resize(pDatos->nNumSalidas);
+	this->bSesgo = sesgo;
+	if (!f or inicializar(nl, npl, tipoSalida == 1) == EXIT_FAILURE) {
+		std::cerr << "\n # Topología de red incorrecta en " << archivo << "." << std::endl;
+		return EXIT_FAILURE;
 	}
 
-	// Se procede a leer los valores de entrada y salida de patrones
-	for(int i=0; i<pDatos->nNumPatrones; i++) {
-		// Se incluyen las entradas en la matriz
-		for(int j=0; j<pDatos->nNumEntradas; j++)
-			f >> pDatos->entradas[i][j];
+	// Si la red ya estaba reservada, no deben quedar los momentos de su entrenamiento anterior
+	reiniciar();
+	this->nNumPatronesVistos = 0;
 
-		// Se incluyen las salidas en la matriz
-		for(int j=0; j<pDatos->nNumSalidas; j++)
-			f >> pDatos->salidas[i][j];
+	for(size_t i=0; i<this->nNumPesos; i++)
+		f >> this->pPesos[i];
+
+	if (!f) {
+		std::cerr << "\n # Faltan pesos en el fichero " << archivo << "." << std::endl;
+		return EXIT_FAILURE;
 	}
 
-	// Se cierra el fichero de texto
-	f.close();
+	// Los ficheros guardados antes de incluir el estado del optimizador terminan aquí
+	std::string etiqueta;
+	if (!(f >> etiqueta))
+		return EXIT_SUCCESS;
 
-	return pDatos;
+	if (etiqueta == "estado")
+		f >> this->nNumPatronesVistos;
+	for(size_t i=0; f and etiqueta == "estado" and i<this->nNumPesos; i++)
+		f >> this->pUltimosCambios[i];
+
+	if (!f or etiqueta != "estado") {
+		std::cerr << "\n # Estado del optimizador incorrecto en el fichero " << archivo << "." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// Las redes sin podar terminan aquí; las podadas recuperan la máscara para que sus pesos podados sigan a cero
+	if (!(f >> etiqueta))
+		return EXIT_SUCCESS;
+
+	size_t nPodados = 0;
+	bool bCorrecta = (etiqueta == "mascara" and f >> nPodados and nPodados <= this->nNumPesos);
+	if (bCorrecta) {
+		memset(this->pMascara, 1, this->nNumPesos);
+		this->bPodada = true;
+	}
+	for(size_t k=0; bCorrecta and k<nPodados; k++) {
+		size_t i;
+		bCorrecta = (f >> i and i < this->nNumPesos and this->pPesos[i] == 0.0);
+		if (bCorrecta)
+			this->pMascara[i] = 0;
+	}
+
+	if (!bCorrecta) {
+		this->bPodada = false;
+		std::cerr << "\n # Máscara de la poda incorrecta en el fichero " << archivo << "." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
 }
 
 // ------------------------------
@@ -403,23 +1280,61 @@ imc::Datos* imc::PerceptronMulticapa::leerDatos(const char * archivo) {
 // Si es offline, después de pasar por ellos hay que ajustar pesos. Sino, ya se ha ajustado en cada patrón
 void imc::PerceptronMulticapa::entrenar(Datos* pDatosTrain, const int &funcionError) {
 
+	entrenar(crearVista(pDatosTrain),funcionError);
+}
+
+// ------------------------------
+// Entrenar la red con los patrones de una vista (pasar una vez por todos los patrones de la vista)
+void imc::PerceptronMulticapa::entrenar(const Vista &vistaTrain, const int &funcionError) {
+
 	// Se establecen los valores de delta a 0
-	for(int h=1; h<this->nNumCapas; h++) {
-		for(int j=0; j<this->pCapas[h].nNumNeuronas; j++) {
-			for(int i=0; i<this->pCapas[h-1].nNumNeuronas; i++)
-				this->pCapas[h].pNeuronas[j].deltaW[i] = 0.0;
+	if (this->pCambios != NULL)
+		memset(this->pCambios, 0, this->nNumPesos * sizeof(double));
 
-			if (this->bSesgo)
-				this->pCapas[h].pNeuronas[j].deltaW[this->pCapas[h-1].nNumNeuronas] = 0.0;
-		}
+	for(size_t i=0; i<vistaTrain.indices.size(); i++) {
+		int p = vistaTrain.indices[i];
+		simularRed(vistaTrain.pDatos->entradas[p].data(), vistaTrain.pDatos->clases[p], funcionError);
 	}
 
-	for(int i=0; i<pDatosTrain->nNumPatrones; i++)
-		simularRed(pDatosTrain->entradas[i], pDatosTrain->salidas[i], funcionError);
+	// Una vez terminadas todas las iteraciones, hay que ajustar los pesos en la versión Off-line
+	// En el entrenamiento distribuido, antes se suman los cambios de todos los procesos
+	if (!this->bOnline) {
+		if (this->pComunicador != NULL)
+			sumarCambiosDistribuidos();
+		ajustarPesos();
+	}
+}
+
+// ------------------------------
+// Entrenar la red durante una época con los bloques de patrones que entrega la canalización
+// Los patrones llegan ya barajados y agrupados por el hilo productor
+void imc::PerceptronMulticapa::entrenar(CanalizacionPatrones &canalizacion, const int &funcionError) {
+
+	// Se establecen los valores de delta a 0
+	if (this->pCambios != NULL)
+		memset(this->pCambios, 0, this->nNumPesos * sizeof(double));
+
+	int nNumEntradas = canalizacion.getDatos()->nNumEntradas;
+
+	// Se consumen bloques hasta completar una pasada por todos los patrones
+	bool bFinEpoca = false;
+	while (!bFinEpoca) {
+		const BloquePatrones &bloque = canalizacion.siguienteBloque();
+
+		for(int p=0; p<bloque.nNumPatrones; p++)
+			simularRed(&bloque.entradas[p*nNumEntradas], bloque.clases[p], funcionError);
+
+		bFinEpoca = bloque.bUltimoEpoca;
+		canalizacion.liberarBloque();
+	}
 
 	// Una vez terminadas todas las iteraciones, hay que ajustar los pesos en la versión Off-line
-	if (!this->bOnline)
+	// En el entrenamiento distribuido, antes se suman los cambios de todos los procesos
+	if (!this->bOnline) {
+		if (this->pComunicador != NULL)
+			sumarCambiosDistribuidos();
 		ajustarPesos();
+	}
 }
 
 // ------------------------------
@@ -427,78 +1342,155 @@ void imc::PerceptronMulticapa::entrenar(Datos* pDatosTrain, const int &funcionEr
 // funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
 double imc::PerceptronMulticapa::test(Datos* pDatosTest, const int &funcionError) {
 
-	double dAvgTestError = 0;
-	for(int i=0; i<pDatosTest->nNumPatrones; i++) {
-		// Cargamos las entradas y propagamos el valor
-		alimentarEntradas(pDatosTest->entradas[i]);
-		propagarEntradas();
-		dAvgTestError += calcularErrorSalida(pDatosTest->salidas[i],funcionError);
-	}
-	dAvgTestError /= pDatosTest->nNumPatrones;
-	return dAvgTestError;
+	return test(crearVista(pDatosTest),funcionError);
 }
 
 // ------------------------------
-// Probar la red con un conjunto de datos y devolver el error CCR cometido
-double imc::PerceptronMulticapa::testClassification(Datos* pDatosTest) {
-
-	// Variable con el valor del ccr
-	double CCR = 0.0;
-
-	// Matriz de confusión
-	std::vector<std::vector<int> > matrizConfusion(pDatosTest->nNumSalidas,std::vector<int>(pDatosTest->nNumSalidas,0));
+// Tamaño en bytes de la memoria que reserva la evaluación: los vectores de trabajo de evaluar (entradas, salidas y
+// capas ocultas de un lote en cada hilo) y, con la evaluación en segundo plano, la red evaluadora y las copias de pesos
+// Se cuenta el máximo: todos los hilos de evaluación con lotes completos y todas las copias pendientes
+size_t imc::PerceptronMulticapa::getMemoriaEvaluacion() const {
+
+	int nMaxNeuronas = 0;
+	for(int h=1; h<this->nNumCapas-1; h++)
+		nMaxNeuronas = std::max(nMaxNeuronas, this->pCapas[h].nNumNeuronas);
+
+	size_t nPorHilo = (size_t) TAM_LOTE_EVALUACION * (this->pCapas[0].nNumNeuronas + this->pCapas[this->nNumCapas-1].nNumNeuronas + 2 * nMaxNeuronas);
+	size_t nTamTrabajo = this->nHilosEvaluacion * nPorHilo * sizeof(double);
+
+	// La evaluación en segundo plano (no disponible en el entrenamiento distribuido) usa una red con la misma topología,
+	// que evalúa con sus propios vectores de trabajo, y hasta nRetrasoEvaluacion+1 copias de los pesos a la vez
+	// (las pendientes y la que se está evaluando)
+	if (this->nRetrasoEvaluacion > 0 and this->pComunicador == NULL)
+		return 2 * nTamTrabajo + this->nTamBloque + (this->nRetrasoEvaluacion + 1) * this->nNumPesos * sizeof(double);
+	return nTamTrabajo;
+}
 
-	for(int i=0; i<pDatosTest->nNumPatrones; i++) {
+// ------------------------------
+// Evaluar la red con los patrones de una vista en una sola pasada por lotes (repartida entre nHilosEvaluacion hilos)
+// Se obtienen a la vez MSE, entropía cruzada, CCR, matriz de confusión y, si se piden, las predicciones
+imc::Evaluacion imc::PerceptronMulticapa::evaluar(const Vista &vista, const bool &bPredicciones) const {
+
+	Datos * pDatos = vista.pDatos;
+	int nNumEntradas = pDatos->nNumEntradas;
+	int nNumSalidas = this->pCapas[this->nNumCapas-1].nNumNeuronas;
+	int nNumPatrones = vista.indices.size();
+	int nNumLotes = (nNumPatrones + TAM_LOTE_EVALUACION - 1) / TAM_LOTE_EVALUACION;
+	int nHilos = std::max(1, std::min(this->nHilosEvaluacion, nNumLotes));
+
+	Evaluacion evaluacion;
+	if (bPredicciones)
+		evaluacion.predicciones.resize((size_t) nNumPatrones * nNumSalidas);
+
+	// Cada hilo acumula sus sumas y su matriz de confusión por separado y se juntan al final
+	std::vector<Evaluacion> parciales(nHilos);
+
+	// El hilo k procesa los lotes k, k+nHilos, k+2*nHilos...
+	auto evaluarLotes = [&](const int &k) {
+		Evaluacion &parcial = parciales[k];
+		parcial.dMSE = parcial.dEntropia = parcial.dCCR = 0.0;
+		parcial.matrizConfusion.assign(nNumSalidas, std::vector<int>(nNumSalidas, 0));
+
+		std::vector<double> entradas((size_t) TAM_LOTE_EVALUACION * nNumEntradas);
+		std::vector<double> salidas((size_t) TAM_LOTE_EVALUACION * nNumSalidas);
+		std::vector<double> trabajo;
+
+		for(int l=k; l<nNumLotes; l+=nHilos) {
+			int inicio = l * TAM_LOTE_EVALUACION;
+			int nPatrones = std::min(TAM_LOTE_EVALUACION, nNumPatrones - inicio);
+
+			// Los patrones de la vista se copian de forma contigua para propagar el lote
+			for(int p=0; p<nPatrones; p++)
+				memcpy(&entradas[(size_t) p * nNumEntradas], pDatos->entradas[vista.indices[inicio + p]].data(), nNumEntradas * sizeof(double));
+
+			propagarLote(entradas.data(), nPatrones, salidas.data(), trabajo);
+
+			for(int p=0; p<nPatrones; p++) {
+				int indiceDeseado = pDatos->clases[vista.indices[inicio + p]];
+				const double * salida = &salidas[(size_t) p * nNumSalidas];
+
+				// Errores del patrón, divididos entre el número de neuronas de salida
+				// En la entropía cruzada solo cuenta la salida de la clase deseada
+				double mse = 0.0;
+				for(int j=0; j<nNumSalidas; j++) {
+					double objetivo = (j == indiceDeseado) ? 1.0 : 0.0;
+					mse += (objetivo - salida[j]) * (objetivo - salida[j]);
+				}
+				parcial.dMSE += mse / nNumSalidas;
+				parcial.dEntropia += -log(salida[indiceDeseado]) / nNumSalidas;
+
+				// Clase predicha (la de mayor probabilidad de pertenencia)
+				int indiceObtenido = 0;
+				double valorMaxObtenido = 0.0;
+				for(int j=0; j<nNumSalidas; j++) {
+					if (salida[j] > valorMaxObtenido) {
+						valorMaxObtenido = salida[j];
+						indiceObtenido = j;
+					}
+				}
+				parcial.matrizConfusion[indiceDeseado][indiceObtenido]++;
+				if (indiceDeseado == indiceObtenido)
+					parcial.dCCR++;
+			}
 
-		// Cargamos las entradas y propagamos el valor
-		alimentarEntradas(pDatosTest->entradas[i]);
-		propagarEntradas();
+			if (bPredicciones)
+				memcpy(&evaluacion.predicciones[(size_t) inicio * nNumSalidas], salidas.data(), (size_t) nPatrones * nNumSalidas * sizeof(double));
+		}
+	};
+
+	if (nHilos == 1)
+		evaluarLotes(0);
+	else {
+		std::vector<std::thread> hilos;
+		for(int k=0; k<nHilos; k++)
+			hilos.push_back(std::thread(evaluarLotes, k));
+		for(int k=0; k<nHilos; k++)
+			hilos[k].join();
+	}
 
-		// Índice con la clase que se espera que se encuentre un patrón
-        int indiceDeseado = 0;
+	// Se juntan los resultados parciales de todos los hilos
+	evaluacion.dMSE = evaluacion.dEntropia = evaluacion.dCCR = 0.0;
+	evaluacion.matrizConfusion.assign(nNumSalidas, std::vector<int>(nNumSalidas, 0));
+	for(int k=0; k<nHilos; k++) {
+		evaluacion.dMSE += parciales[k].dMSE;
+		evaluacion.dEntropia += parciales[k].dEntropia;
+		evaluacion.dCCR += parciales[k].dCCR;
+		for(int d=0; d<nNumSalidas; d++)
+			for(int o=0; o<nNumSalidas; o++)
+				evaluacion.matrizConfusion[d][o] += parciales[k].matrizConfusion[d][o];
+	}
+	evaluacion.dMSE /= nNumPatrones;
+	evaluacion.dEntropia /= nNumPatrones;
+	evaluacion.dCCR = 100 * (evaluacion.dCCR / nNumPatrones);
 
-        // Índice con la clase que se predice que se encuentre un patrón
-        int indiceObtenido = 0;
+	return evaluacion;
+}
 
-        // Valor de la salida obtenida con mayor probabilidad de pertenencia
-        double valorMaxObtenido = 0.0;
+// ------------------------------
+// Probar la red con los patrones de una vista y devolver el error cometido
+double imc::PerceptronMulticapa::test(const Vista &vistaTest, const int &funcionError) {
 
-        // Se comprueba cómo de bien se han clasificado los patrones
-        for(int j=0; j<this->pCapas[this->nNumCapas-1].nNumNeuronas; j++) {
+	return evaluar(vistaTest,false).error(funcionError);
+}
 
-        	// Se busca el índice de la clase que se espera que esté dicho patrón
-            if(pDatosTest->salidas[i][j] == 1)
-                indiceDeseado = j;
+// ------------------------------
+// Probar la red con un conjunto de datos y devolver el error CCR cometido
+double imc::PerceptronMulticapa::testClassification(Datos* pDatosTest) {
 
-            // Se hace caso a la probabilidad de pertenencia mayor para calcular el índice de la clase
-            // en la que se ha clasificado al patrón por predicción
-            if(this->pCapas[this->nNumCapas-1].pNeuronas[j].x > valorMaxObtenido) {
-            	valorMaxObtenido = this->pCapas[this->nNumCapas-1].pNeuronas[j].x;
-                indiceObtenido = j;
-            }
-        }
+	return testClassification(crearVista(pDatosTest));
+}
 
-        // Se añade el patrón a la matriz de confusión
-        matrizConfusion[indiceDeseado][indiceObtenido]++;
+// ------------------------------
+// Probar la red con los patrones de una vista y devolver el error CCR cometido
+double imc::PerceptronMulticapa::testClassification(const Vista &vistaTest) {
 
-        // Se incrementa el ccr si el indiceDeseado y Obtenido son iguales
-        // Es decir, si el patrón predicho se ha clasificado correctamente
-        if(indiceDeseado == indiceObtenido)
-            CCR++;
-        //else
-        	//std::cout << "\n # Patrón mal clasificado: <" << i+1 << ">\n Pertenece a " << indiceDeseado << " - Clasificado como " << indiceObtenido << std::endl;
-	}
+	Evaluacion evaluacion = evaluar(vistaTest,false);
 
 	// Se imprime la matriz de confusión generada
-	for(int i=0; i<pDatosTest->nNumSalidas; i++) {
-		std::cout << "|";
-		for(int j=0; j<pDatosTest->nNumSalidas; j++)
-			std::cout << " " << matrizConfusion[i][j];
-		std::cout << " |" << std::endl;
-	}
+	if (!this->bSilencioso)
+		imprimirMatrizConfusion(evaluacion.matrizConfusion);
 
-	// Se calcula el CCR final y se devuelve
-	return 100 * (CCR / pDatosTest->nNumPatrones);
+	return evaluacion.dCCR;
 }
 
 // ------------------------------
@@ -508,11 +1500,37 @@ double imc::PerceptronMulticapa::testClassification(Datos* pDatosTest) {
 // funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
 void imc::PerceptronMulticapa::ejecutarAlgoritmo(Datos * pDatosTrain, Datos * pDatosTest, const int &maxiter, double &errorTrain, double &errorTest, double &ccrTrain, double &ccrTest, const int &funcionError)
 {
+	ejecutarAlgoritmo(crearVista(pDatosTrain),crearVista(pDatosTest),maxiter,errorTrain,errorTest,ccrTrain,ccrTest,funcionError);
+}
+
+// ------------------------------
+// Ejecutar el algoritmo de entrenamiento con los patrones de la vista de entrenamiento
+// y probar la red con los patrones de la vista de test
+void imc::PerceptronMulticapa::ejecutarAlgoritmo(const Vista &vistaTrain, const Vista &vistaTest, const int &maxiter, double &errorTrain, double &errorTest, double &ccrTrain, double &ccrTest, const int &funcionError)
+{
+	Datos * pDatosTest = vistaTest.pDatos;
+
+	// En el entrenamiento distribuido cada proceso entrena solo con su parte de los patrones
+	Vista vistaLocal = vistaTrain;
+	if (this->pComunicador != NULL) {
+		vistaLocal.indices.clear();
+		for(size_t i=this->pComunicador->getRango(); i<vistaTrain.indices.size(); i+=this->pComunicador->getNumProcesos())
+			vistaLocal.indices.push_back(vistaTrain.indices[i]);
+	}
+
 	int countTrain = 0;
 
-	// Inicialización de pesos
+	// Se reinicia el estado de la red en su sitio (momentos de la semilla anterior incluidos)
+	// e inicialización de pesos
+	reiniciar();
 	pesosAleatorios();
 
+	// Si se barajan los patrones, un hilo productor prepara los bloques de cada época
+	// La semilla de la permutación se deriva de la semilla de la ejecución
+	CanalizacionPatrones * pCanalizacion = NULL;
+	if (this->bBarajar)
+		pCanalizacion = new CanalizacionPatrones(vistaLocal, TAM_BLOQUE_CANALIZACION, true, this->generador());
+
 	double minTrainError = 0.0;
 	int numSinMejorar;
 
@@ -520,33 +1538,70 @@ void imc::PerceptronMulticapa::ejecutarAlgoritmo(Datos * pDatosTrain, Datos * pD
 	clock_t t;
 	t = clock();
 
-	// Aprendizaje del algoritmo
-	do {
+	// La evaluación en segundo plano no se usa en el entrenamiento distribuido,
+	// porque la suma del error entre procesos no puede mezclarse con la de los cambios
+	this->historialEvaluacion.clear();
+	if (this->nRetrasoEvaluacion > 0 and this->pComunicador == NULL)
+		minTrainError = entrenarEvaluacionAsincrona(vistaLocal,vistaTest,pCanalizacion,maxiter,funcionError,this->historialEvaluacion);
 
-		entrenar(pDatosTrain,funcionError);
+	// Aprendizaje del algoritmo
+	else {
+		do {
+
+			if (pCanalizacion != NULL)
+				entrenar(*pCanalizacion,funcionError);
+			else
+				entrenar(vistaLocal,funcionError);
+
+			double trainError = evaluar(vistaLocal,false).error(funcionError);
+
+			// El error de entrenamiento global es la media ponderada de los errores de cada proceso
+			// Todos los procesos obtienen el mismo valor y toman las mismas decisiones de parada
+			if (this->pComunicador != NULL) {
+				double errorGlobal[2] = {trainError * vistaLocal.indices.size(), (double) vistaLocal.indices.size()};
+				this->pComunicador->sumarTodos(errorGlobal, 2);
+				trainError = errorGlobal[0] / errorGlobal[1];
+			}
+			// El 0.00001 es un valor de tolerancia, podría parametrizarse
+			if(countTrain==0 or fabs(trainError - minTrainError) > 0.00001){
+				minTrainError = trainError;
+				copiarPesos();
+				numSinMejorar = 0;
+			}else
+				numSinMejorar++;
 
-		double trainError = test(pDatosTrain,funcionError);
-		// El 0.00001 es un valor de tolerancia, podría parametrizarse
-		if(countTrain==0 or fabs(trainError - minTrainError) > 0.00001){
-			minTrainError = trainError;
-			copiarPesos();
-			numSinMejorar = 0;
-		}else
-			numSinMejorar++;
+			if(numSinMejorar==50)
+				countTrain = maxiter;
 
-		if(numSinMejorar==50)
-			countTrain = maxiter;
+			countTrain++;
 
-		countTrain++;
+			if (!this->bSilencioso)
+				std::cout << "Iteración " << countTrain << "\t Error de entrenamiento: " << trainError << std::endl;
+			//std::cout << "Iteración " << countTrain << "\t CCR de test: " << testClassification(pDatosTest) << std::endl;
+			//std::cout << "Iteración " << countTrain << "\t | " << trainError << " | " << test(pDatosTest,funcionError) << " | " << testClassification(pDatosTrain) << " | " << testClassification(pDatosTest) << " |" << std::endl;
 
-		std::cout << "Iteración " << countTrain << "\t Error de entrenamiento: " << trainError << std::endl;
-		//std::cout << "Iteración " << countTrain << "\t CCR de test: " << testClassification(pDatosTest) << std::endl;
-		//std::cout << "Iteración " << countTrain << "\t | " << trainError << " | " << test(pDatosTest,funcionError) << " | " << testClassification(pDatosTrain) << " | " << testClassification(pDatosTest) << " |" << std::endl;
+		} while ( countTrain<maxiter );
+	}
 
-	} while ( countTrain<maxiter );
+	// Se detiene el hilo productor de la canalización
+	delete pCanalizacion;
 
 	// Termina de contar el tiempo
 	t = clock() - t;
+
+	errorTrain = minTrainError;
+
+	// Una sola pasada por cada conjunto: errores, CCR, matrices de confusión y predicciones de test
+	Evaluacion evaluacionTrain = evaluar(vistaTrain,false);
+	Evaluacion evaluacionTest = evaluar(vistaTest,!this->bSilencioso);
+	errorTest = evaluacionTest.error(funcionError);
+	ccrTrain = evaluacionTrain.dCCR;
+	ccrTest = evaluacionTest.dCCR;
+
+	// En modo silencioso solo se calculan los errores y CCRs finales
+	if (this->bSilencioso)
+		return;
+
 	std::cout << "\n # Tiempo en entrenar: " << ((float)t)/CLOCKS_PER_SEC << " segundos" << std::endl;;
 
 	std::cout << "\nPesos de la red" << std::endl;
@@ -555,27 +1610,92 @@ void imc::PerceptronMulticapa::ejecutarAlgoritmo(Datos * pDatosTrain, Datos * pD
 
 	std::cout << "Salida Esperada Vs Salida Obtenida (test)" << std::endl;
 	std::cout << "=========================================" << std::endl;
-	for(int i=0; i<pDatosTest->nNumPatrones; i++) {
-		std::vector<double> prediccion(pDatosTest->nNumSalidas);
+	for(size_t k=0; k<vistaTest.indices.size(); k++) {
+		int i = vistaTest.indices[k];
+		const double * prediccion = &evaluacionTest.predicciones[k * pDatosTest->nNumSalidas];
 
-		// Cargamos las entradas y propagamos el valor
-		alimentarEntradas(pDatosTest->entradas[i]);
-		propagarEntradas();
-		recogerSalidas(prediccion);
 		for(int j=0; j<pDatosTest->nNumSalidas; j++)
-			std::cout << pDatosTest->salidas[i][j] << " -- " << prediccion[j]<< " \\\\ " ;
+			std::cout << (j == pDatosTest->clases[i]) << " -- " << prediccion[j]<< " \\\\ " ;
 			//std::cout << prediccion[j]<< ";" ;
 		std::cout << std::endl;
-		prediccion.clear();
-
 	}
 
-	errorTest = test(pDatosTest,funcionError);
-	errorTrain = minTrainError;
-
 	std::cout << "\n # Entrenamiento - Matriz de confusión:" << std::endl;
-	ccrTrain = testClassification(pDatosTrain);
+	imprimirMatrizConfusion(evaluacionTrain.matrizConfusion);
 
 	std::cout << "\n # Test - Matriz de confusión:" << std::endl;
-	ccrTest = testClassification(pDatosTest);
+	imprimirMatrizConfusion(evaluacionTest.matrizConfusion);
+}
+
+// ------------------------------
+// Continuar el entrenamiento de una red ya cargada (pesos y momentos) con los patrones de la vista de entrenamiento
+// No se reinician los pesos: se para cuando el error de entrenamiento lleva PACIENCIA_INCREMENTAL épocas sin mejorar
+// y la red se queda con los mejores pesos encontrados, incluidos los de partida
+int imc::PerceptronMulticapa::ejecutarIncremental(const Vista &vistaTrain, const Vista &vistaTest, const int &maxiter, double &errorTrain, double &errorTest, double &ccrTrain, double &ccrTest, const int &funcionError)
+{
+	// Si se barajan los patrones, un hilo productor prepara los bloques de cada época
+	CanalizacionPatrones * pCanalizacion = NULL;
+	if (this->bBarajar)
+		pCanalizacion = new CanalizacionPatrones(vistaTrain, TAM_BLOQUE_CANALIZACION, true, this->generador());
+
+	// Los pesos de partida son la referencia: el entrenamiento solo los sustituye si mejora su error
+	double minTrainError = evaluar(vistaTrain,false).error(funcionError);
+	copiarPesos();
+
+	if (!this->bSilencioso)
+		std::cout << "Iteración 0\t Error de entrenamiento: " << minTrainError << std::endl;
+
+	// Indica si los pesos actuales de la red son los mejores, en cuyo caso no hace falta restaurar la copia
+	// (que en el modo de memoria reducida está en float16 y no es exacta)
+	bool bActualesMejores = true;
+
+	int countTrain = 0;
+	int numSinMejorar = 0;
+	while (countTrain < maxiter and numSinMejorar < PACIENCIA_INCREMENTAL) {
+
+		if (pCanalizacion != NULL)
+			entrenar(*pCanalizacion,funcionError);
+		else
+			entrenar(vistaTrain,funcionError);
+
+		double trainError = evaluar(vistaTrain,false).error(funcionError);
+		countTrain++;
+
+		// Solo cuenta como mejora una bajada del error mayor que la tolerancia
+		if (trainError < minTrainError - 0.00001) {
+			minTrainError = trainError;
+			copiarPesos();
+			numSinMejorar = 0;
+			bActualesMejores = true;
+		}else {
+			numSinMejorar++;
+			bActualesMejores = false;
+		}
+
+		if (!this->bSilencioso)
+			std::cout << "Iteración " << countTrain << "\t Error de entrenamiento: " << trainError << std::endl;
+	}
+
+	// Se detiene el hilo productor de la canalización
+	delete pCanalizacion;
+
+	// La red se queda con los mejores pesos encontrados
+	if (!bActualesMejores)
+		restaurarPesos();
+
+	// El error de entrenamiento se mide con los pesos que tiene la red al final:
+	// si se han restaurado desde la copia en float16, no son exactamente los que se evaluaron
+	Evaluacion evaluacionTrain = evaluar(vistaTrain,false);
+	Evaluacion evaluacionTest = evaluar(vistaTest,false);
+	errorTrain = evaluacionTrain.error(funcionError);
+	errorTest = evaluacionTest.error(funcionError);
+	ccrTrain = evaluacionTrain.dCCR;
+	ccrTest = evaluacionTest.dCCR;
+
+	if (!this->bSilencioso) {
+		std::cout << "\n # Test - Matriz de confusión:" << std::endl;
+		imprimirMatrizConfusion(evaluacionTest.matrizConfusion);
+	}
+
+	return countTrain;
 }
@@ -6,33 +6,78 @@
 #ifndef _PERCEPTRONMULTICAPA_HPP_
 #define _PERCEPTRONMULTICAPA_HPP_
 
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <algorithm>
+
 namespace imc {
 
+class CanalizacionPatrones;
+class Comunicador;
+class GrupoHilos;
+
 // Estructuras para la red neuronal
 // ---------------------
+// Los vectores de cada neurona apuntan al bloque de memoria único de la red (ver inicializar)
 struct Neurona {
 	double x;  /* Salida producida por la neurona (out_j^h)*/
 	double dX; /* Derivada de la salida producida por la neurona (delta_j)*/
-	std::vector<double> w;            /* Vector de pesos de entrada (w_{ji}^h)*/
-	std::vector<double> deltaW;       /* Cambio a aplicar a cada peso de entrada (\Delta_{ji}^h (t))*/
-	std::vector<double> ultimoDeltaW; /* Último cambio aplicada a cada peso (\Delta_{ji}^h (t-1))*/
-	std::vector<double> wCopia;       /* Copia de los pesos de entrada */
+	double * w;            /* Vector de pesos de entrada (w_{ji}^h)*/
+	double * deltaW;       /* Cambio a aplicar a cada peso de entrada (\Delta_{ji}^h (t))*/
+	double * ultimoDeltaW; /* Último cambio aplicada a cada peso (\Delta_{ji}^h (t-1))*/
+	double * wCopia;       /* Copia de los pesos de entrada */
 };
 
 struct Capa {
 	int nNumNeuronas; /* Número de neuronas de la capa*/
 	int tipo;         /* Tipo de la capa (0=> sigmoide, 1=> softmax)*/
-	std::vector<Neurona> pNeuronas; /* Vector con las neuronas de la capa*/
+	Neurona * pNeuronas; /* Vector con las neuronas de la capa (dentro del bloque de la red)*/
 };
 
 struct Datos {
 	int nNumEntradas; /* Número de entradas */
-	int nNumSalidas;  /* Número de salidas */
+	int nNumSalidas;  /* Número de salidas (una por clase) */
 	int nNumPatrones; /* Número de patrones */
 	std::vector<std::vector<double> > entradas; /* Matriz con las entradas del problema */
-	std::vector<std::vector<double> > salidas;  /* Matriz con las salidas del problema */
+	std::vector<int> clases; /* Clase de cada patrón (índice de la salida que vale 1 en la codificación 1 de n) */
+};
+
+struct Vista {
+	Datos * pDatos;           /* Conjunto de datos sobre el que se define la vista */
+	std::vector<int> indices; /* Índices de los patrones de pDatos que forman la vista (sin copiar los datos) */
+};
+
+// Resultado de una única pasada de evaluación sobre los patrones de una vista
+struct Evaluacion {
+	double dMSE;      /* Error MSE medio por patrón */
+	double dEntropia; /* Entropía cruzada media por patrón */
+	double dCCR;      /* Porcentaje de patrones bien clasificados */
+	std::vector<std::vector<int> > matrizConfusion; /* Filas => clase deseada, columnas => clase obtenida */
+	std::vector<double> predicciones; /* Salidas de la red por filas, en el orden de la vista (solo si se piden) */
+
+	// Error según la función de error del entrenamiento
+	// funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
+	inline double error(const int &funcionError) const {
+		return funcionError ? this->dEntropia : this->dMSE;
+	}
+};
+
+// Resultados de la evaluación en segundo plano de la copia de pesos de una época
+struct EvaluacionEpoca {
+	int nEpoca;          /* Época (desde 1) de la copia de pesos evaluada */
+	double dErrorTrain;  /* Error de entrenamiento */
+	double dErrorTest;   /* Error de test */
+	double dCCRTrain;    /* CCR de entrenamiento */
+	double dCCRTest;     /* CCR de test */
 };
 
+// Crear una vista que contiene todos los patrones de un conjunto de datos, en el orden del fichero
+Vista crearVista(Datos * pDatos);
+
+// Imprimir una matriz de confusión (filas => clase deseada, columnas => clase obtenida)
+void imprimirMatrizConfusion(const std::vector<std::vector<int> > &matrizConfusion);
+
 class PerceptronMulticapa {
 private:
 	int nNumCapas; /* Número de capas total en la red */
@@ -43,15 +88,41 @@ private:
 	double dMu;         // Factor de momento
 	bool   bSesgo;      // ¿Van a tener sesgo las neuronas?
 	bool   bOnline;     // ¿El aprendizaje va a ser online? (true->online,false->offline)
+	bool   bBarajar;    // ¿Se barajan los patrones de entrenamiento en cada época?
+	bool   bSilencioso; // ¿Se omiten los mensajes por pantalla durante el entrenamiento y el test?
+	int    nHilosEvaluacion; // Nº de hilos con los que se reparte cada pasada de evaluación
+	long   nNumPatronesVistos; // Nº de patrones del fichero de entrenamiento con los que ya se ha entrenado la red
+	int    nRetrasoEvaluacion; // Nº máximo de épocas que el entrenamiento se adelanta a la evaluación (0 => evaluación síncrona)
+	bool   bAhorroMemoria; // ¿Se entrena en el modo de memoria reducida? (on-line, sin deltaW y con la copia de pesos en float16)
+
+	// Generador de números aleatorios propio de la red (pesos iniciales y permutaciones)
+	std::mt19937 generador;
+
+	// Comunicador con el resto de procesos en el entrenamiento distribuido (NULL => un solo proceso)
+	Comunicador * pComunicador;
+
+	// Bloque único de memoria (alineado a 64 bytes) con las neuronas y todos los vectores de pesos
+	// Cada sección guarda de forma contigua los valores de todas las capas, una fila por neurona
+	char * pBloque;           /* Inicio del bloque */
+	size_t nTamBloque;        /* Tamaño del bloque en bytes */
+	size_t nNumPesos;         /* Número total de pesos de la red (incluidos los sesgos) */
+	double * pPesos;          /* Sección con los pesos (w) */
+	double * pCambios;        /* Sección con los cambios (deltaW) */
+	double * pUltimosCambios; /* Sección con los últimos cambios (ultimoDeltaW) */
+	double * pCopiaPesos;     /* Sección con la copia de los pesos (wCopia) */
+	uint16_t * pCopiaComprimida; /* Sección con la copia de los pesos en float16 (solo en el modo de memoria reducida) */
+	double * pSumatorios;     /* Sección de trabajo de la retropropagación (una posición por neurona de la capa más ancha) */
+	unsigned char * pMascara; /* Sección con la máscara de la poda, paralela a la de pesos (0 => peso podado) */
+	bool bPodada;             /* ¿Se aplica la máscara? (false => red sin podar, la sección no se usa) */
+
+	// Resultados de cada época evaluada en segundo plano en la última ejecución (vacío con la evaluación síncrona)
+	std::vector<EvaluacionEpoca> historialEvaluacion;
 
 	// Liberar memoria para las estructuras de datos
 	void liberarMemoria();
 
-	// Rellenar todos los pesos (w) aleatoriamente entre -1 y 1
-	void pesosAleatorios();
-
 	// Alimentar las neuronas de entrada de la red con un patrón pasado como argumento
-	void alimentarEntradas(const std::vector<double> &entrada);
+	void alimentarEntradas(const double * entrada);
 
 	// Recoger los valores predichos por la red (out de la capa de salida) y almacenarlos en el vector pasado como argumento
 	void recogerSalidas(std::vector<double> &salida);
@@ -59,19 +130,29 @@ private:
 	// Hacer una copia de todos los pesos (copiar w en copiaW)
 	void copiarPesos();
 
+	// Guardar un vector con todos los pesos como copia de la red (en float16 en el modo de memoria reducida)
+	void guardarCopia(const double * pesos);
+
 	// Restaurar una copia de todos los pesos (copiar copiaW en w)
 	void restaurarPesos();
 
 	// Calcular y propagar las salidas de las neuronas, desde la segunda capa hasta la última
 	void propagarEntradas();
 
-	// Calcular el error de salida del out de la capa de salida con respecto a un vector objetivo y devolverlo
+	// Calcular las salidas de las neuronas jInicio..jFin-1 de la capa h para nPatrones patrones (por filas)
+	// En una capa softmax deja exp(salida) sin normalizar
+	void propagarCapa(const int &h, const double * entradaCapa, const int &nPatrones, double * salidaCapa, const int &jInicio, const int &jFin) const;
+
+	// Normalizar por filas las salidas softmax de nPatrones patrones
+	void normalizarSoftmax(double * salidas, const int &nPatrones) const;
+
+	// Calcular el error de salida del out de la capa de salida con respecto a la clase deseada y devolverlo
 	// funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
-	double calcularErrorSalida(const std::vector<double> &objetivo, const int &funcionError);
+	double calcularErrorSalida(const int &clase, const int &funcionError);
 
-	// Retropropagar el error de salida con respecto a un vector pasado como argumento, desde la última capa hasta la primera
+	// Retropropagar el error de salida con respecto a la clase deseada, desde la última capa hasta la primera
 	// funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
-	void retropropagarError(const std::vector<double> &objetivo, const int &funcionError);
+	void retropropagarError(const int &clase, const int &funcionError);
 
 	// Acumular los cambios producidos por un patrón en deltaW
 	void acumularCambio();
@@ -79,15 +160,30 @@ private:
 	// Actualizar los pesos de la red, desde la segunda capa hasta la última
 	void ajustarPesos();
 
+	// Calcular el cambio de cada peso con el patrón actual y aplicarlo en el mismo recorrido (on-line sin sección deltaW)
+	void ajustarPesosFusionado();
+
+	// Mantener a cero los pesos podados (y sus momentos) después de cada ajuste
+	void aplicarMascara();
+
+	// Sumar los deltaW acumulados por todos los procesos del entrenamiento distribuido
+	void sumarCambiosDistribuidos();
+
+	// Bucle de entrenamiento con la evaluación de cada época en un hilo de fondo, sobre una copia de los pesos
+	// El entrenamiento no se adelanta más de nRetrasoEvaluacion épocas a la última época evaluada
+	// Cada copia se evalúa con los patrones de entrenamiento y de test; los resultados de cada época se dejan en historial
+	// Devuelve el menor error de entrenamiento registrado
+	double entrenarEvaluacionAsincrona(const Vista &vistaTrain, const Vista &vistaTest, CanalizacionPatrones * pCanalizacion, const int &maxiter, const int &funcionError, std::vector<EvaluacionEpoca> &historial);
+
 	// Imprimir la red, es decir, todas las matrices de pesos
 	void imprimirRed();
 
 	// Simular la red: propagar las entradas hacia delante, retropropagar el error y ajustar los pesos
-	// entrada es el vector de entradas del patrón y objetivo es el vector de salidas deseadas del patrón
+	// entrada es el vector de entradas del patrón y clase es la clase deseada del patrón
 	// El paso de ajustar pesos solo deberá hacerse si el algoritmo es on-line
 	// Si no lo es, el ajuste de pesos hay que hacerlo en la función "entrenar"
 	// funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
-	void simularRed(const std::vector<double> &entrada, const std::vector<double> &objetivo, const int &funcionError);
+	void simularRed(const double * entrada, const int &clase, const int &funcionError);
 
 public:
 
@@ -97,6 +193,10 @@ public:
 	// DESTRUCTOR: liberar memoria
 	~PerceptronMulticapa();
 
+	// Las neuronas apuntan al bloque de memoria de la red, por lo que no se permite copiarla
+	PerceptronMulticapa(const PerceptronMulticapa &) = delete;
+	PerceptronMulticapa & operator=(const PerceptronMulticapa &) = delete;
+
 	// Métodos observadores de los parámetros de la red neuronal
 
 	inline bool isSesgo() const {
@@ -115,6 +215,62 @@ public:
 		return this->bOnline;
 	}
 
+	inline bool isBarajar() const {
+		return this->bBarajar;
+	}
+
+	inline bool isSilencioso() const {
+		return this->bSilencioso;
+	}
+
+	inline int getHilosEvaluacion() const {
+		return this->nHilosEvaluacion;
+	}
+
+	inline bool isAhorroMemoria() const {
+		return this->bAhorroMemoria;
+	}
+
+	// Tamaño en bytes del bloque de memoria de la red (el mayor reservado, ya que el bloque solo crece)
+	inline size_t getMemoriaParametros() const {
+		return this->nTamBloque;
+	}
+
+	inline int getRetrasoEvaluacion() const {
+		return this->nRetrasoEvaluacion;
+	}
+
+	// Errores y CCR de entrenamiento y test de cada época evaluada en segundo plano en la última ejecución
+	inline const std::vector<EvaluacionEpoca> & getHistorialEvaluacion() const {
+		return this->historialEvaluacion;
+	}
+
+	inline long getPatronesVistos() const {
+		return this->nNumPatronesVistos;
+	}
+
+	// Métodos observadores de la topología de la red neuronal
+
+	inline int getNumCapas() const {
+		return this->nNumCapas;
+	}
+
+	inline int getNumNeuronas(const int &h) const {
+		return this->pCapas[h].nNumNeuronas;
+	}
+
+	inline bool isSoftmax() const {
+		return this->pCapas[this->nNumCapas-1].tipo == 1;
+	}
+
+	// ¿Tiene la red pesos podados (fijados a cero por la máscara de la poda)?
+	inline bool isPodada() const {
+		return this->bPodada;
+	}
+
+	// Copiar los pesos de la capa h (h>0) en destino, por filas: una fila de (nNumNeuronas(h-1) + bSesgo) pesos por neurona
+	void copiarPesosCapa(const int &h, double * destino) const;
+
 	// Métodos modificadores de los parámetros de la red neuronal
 
 	inline void setSesgo(const bool &sesgo) {
@@ -133,31 +289,134 @@ public:
 		this->bOnline = online;
 	}
 
+	inline void setBarajar(const bool &barajar) {
+		this->bBarajar = barajar;
+	}
+
+	inline void setSilencioso(const bool &silencioso) {
+		this->bSilencioso = silencioso;
+	}
+
+	inline void setHilosEvaluacion(const int &hilos) {
+		this->nHilosEvaluacion = std::max(1, hilos);
+	}
+
+	// Modo de memoria reducida para redes muy anchas: solo on-line, sin sección deltaW (cada cambio se aplica
+	// al calcularlo) y con la copia de los mejores pesos en float16. Debe fijarse antes de inicializar la red
+	inline void setAhorroMemoria(const bool &ahorro) {
+		this->bAhorroMemoria = ahorro;
+	}
+
+	// Evaluar cada época en un hilo de fondo mientras se entrena la siguiente (0 => evaluación síncrona)
+	// Las decisiones de parada y de mejor copia de pesos llegan con, como mucho, retraso épocas de retraso
+	inline void setRetrasoEvaluacion(const int &retraso) {
+		this->nRetrasoEvaluacion = std::max(0, retraso);
+	}
+
+	// Los patrones nuevos para el entrenamiento incremental son los que se añadan al fichero después de estos
+	inline void setPatronesVistos(const long &patrones) {
+		this->nNumPatronesVistos = patrones;
+	}
+
+	// Repartir el entrenamiento off-line entre los procesos del comunicador (NULL => un solo proceso)
+	// Cada proceso entrena con su parte de los patrones y los deltaW se suman antes de ajustar los pesos
+	inline void setComunicador(Comunicador * comunicador) {
+		this->pComunicador = comunicador;
+	}
+
+	// Fijar la semilla del generador de la red (sustituye a srand() para poder entrenar varias redes en paralelo)
+	inline void setSemilla(const unsigned int &semilla) {
+		this->generador.seed(semilla);
+	}
+
 	// Reservar memoria para las estructuras de datos
 	// nl tiene el numero de capas y npl es un vector que contiene el número de neuronas por cada una de las capas
 	// Rellenar vector Capa* pCapas
 	int inicializar(const int &nl, const std::vector<int> &npl, const bool &bSigmoideCapaSalida);
 
+	// Reiniciar en su sitio el estado de la red (salidas, cambios, momentos, copias y poda), sin reservar memoria
+	void reiniciar();
+
+	// Rellenar todos los pesos (w) aleatoriamente entre -1 y 1
+	void pesosAleatorios();
+
 	// Leer una matriz de datos a partir de un nombre de fichero y devolverla
+	// El fichero se lee de una vez y se reparte por líneas entre varios hilos (un patrón por línea)
+	// Las salidas de cada patrón deben estar en codificación 1 de n y se guardan como el índice de su clase
+	// Devuelve NULL, tras informar de la cabecera o de las líneas mal formadas, si el fichero no es válido
 	Datos* leerDatos(const char * archivo);
 
+	// Guardar la topología, los pesos y el estado del optimizador (últimos cambios y patrones vistos) en un fichero de texto
+	int guardarRed(const char * archivo) const;
+
+	// Cargar una red guardada con guardarRed, reservando la memoria para su topología
+	// El estado del optimizador es opcional: si el fichero no lo incluye, los momentos empiezan a cero
+	int cargarRed(const char * archivo);
+
+	// Podar por magnitud los pesos de cada capa (los sesgos no se podan): se ponen a cero los pesos con |w| < umbral
+	// y, si dispersion > 0, los de menor magnitud hasta que esa proporción de los pesos de cada capa sea nula
+	// Los pesos podados se mantienen a cero en los entrenamientos posteriores (ajuste fino)
+	// Devuelve el número total de pesos podados
+	int podar(const double &umbral, const double &dispersion);
+
+	// Propagar un lote de nPatrones patrones (entradas por filas) y dejar las salidas de la red por filas en salidas
+	// No modifica el estado de la red, así que varios hilos pueden usarlo a la vez con distintos vectores de trabajo
+	void propagarLote(const double * entradas, const int &nPatrones, double * salidas, std::vector<double> &trabajo) const;
+
+	// Propagar un lote igual que propagarLote, repartiendo el trabajo entre los hilos del grupo (mismos resultados)
+	// Un único patrón reparte las neuronas de cada capa grande entre los hilos, con una barrera entre capas;
+	// un lote de varios patrones se segmenta por capas (cada hilo, una etapa) si las etapas quedan equilibradas
+	void propagarLoteParalelo(const double * entradas, const int &nPatrones, double * salidas, std::vector<double> &trabajo, GrupoHilos &grupo) const;
+
+	// Evaluar la red con los patrones de una vista en una sola pasada por lotes (repartida entre nHilosEvaluacion hilos)
+	// Se obtienen a la vez MSE, entropía cruzada, CCR, matriz de confusión y, si se piden, las predicciones
+	Evaluacion evaluar(const Vista &vista, const bool &bPredicciones) const;
+
+	// Tamaño en bytes de la memoria que reserva la evaluación: los vectores de trabajo de evaluar y,
+	// con la evaluación en segundo plano, la red evaluadora y las copias de pesos pendientes
+	size_t getMemoriaEvaluacion() const;
+
 	// Probar la red con un conjunto de datos y devolver el error MSE cometido
 	// funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
 	double test(Datos* pDatosTest, const int &funcionError);
 
+	// Probar la red con los patrones de una vista y devolver el error cometido
+	double test(const Vista &vistaTest, const int &funcionError);
+
 	// Probar la red con un conjunto de datos y devolver el error CCR cometido
 	double testClassification(Datos* pDatosTest);
 
+	// Probar la red con los patrones de una vista y devolver el error CCR cometido
+	double testClassification(const Vista &vistaTest);
+
 	// Entrenar la red para un determinado fichero de datos (pasar una vez por todos los patrones)
 	// Si es offline, después de pasar por ellos hay que ajustar pesos. Sino, ya se ha ajustado en cada patrón
 	void entrenar(Datos* pDatosTrain, const int &funcionError);
 
+	// Entrenar la red con los patrones de una vista (pasar una vez por todos los patrones de la vista)
+	void entrenar(const Vista &vistaTrain, const int &funcionError);
+
+	// Entrenar la red durante una época con los bloques de patrones que entrega la canalización
+	// Los patrones llegan ya barajados y agrupados por el hilo productor
+	void entrenar(CanalizacionPatrones &canalizacion, const int &funcionError);
+
 	// Ejecutar el algoritmo de entrenamiento durante un número de iteraciones, utilizando pDatosTrain
+	// Si está activado bBarajar, los patrones se entregan barajados mediante una canalización con hilo productor
 	// Una vez terminado, probar como funciona la red en pDatosTest
 	// Tanto el error MSE de entrenamiento como el error MSE de test debe calcularse y almacenarse en errorTrain y errorTest
 	// funcionError=1 => EntropiaCruzada // funcionError=0 => MSE
 	void ejecutarAlgoritmo(Datos * pDatosTrain, Datos * pDatosTest, const int &maxiter, double &errorTrain, double &errorTest, double &ccrTrain, double &ccrTest, const int &funcionError);
 
+	// Ejecutar el algoritmo de entrenamiento con los patrones de la vista de entrenamiento
+	// y probar la red con los patrones de la vista de test
+	void ejecutarAlgoritmo(const Vista &vistaTrain, const Vista &vistaTest, const int &maxiter, double &errorTrain, double &errorTest, double &ccrTrain, double &ccrTest, const int &funcionError);
+
+	// Continuar el entrenamiento de una red ya cargada (pesos y momentos) con los patrones de la vista de entrenamiento
+	// No se reinician los pesos: se para cuando el error de entrenamiento lleva PACIENCIA_INCREMENTAL épocas sin mejorar
+	// y la red se queda con los mejores pesos encontrados, incluidos los de partida
+	// Devuelve el número de épocas realizadas
+	int ejecutarIncremental(const Vista &vistaTrain, const Vista &vistaTest, const int &maxiter, double &errorTrain, double &errorTest, double &ccrTrain, double &ccrTest, const int &funcionError);
+
 };
 
 };
@@ -0,0 +1,154 @@
+/*********************************************************************
+ * File  : redDispersa.cpp
+ * Date  : 2016
+ *********************************************************************/
+
+#include <cstdlib>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// Inclusión del archivo de cabecera de RedDispersa
+#include "redDispersa.hpp"
+
+// ------------------------------
+// CONSTRUCTOR: convertir los pesos actuales de una red (normalmente ya podada) a formato CSR
+imc::RedDispersa::RedDispersa(const PerceptronMulticapa &red) {
+
+	this->nNumCapas = red.getNumCapas();
+	this->bSesgo = red.isSesgo();
+	this->bSoftmax = red.isSoftmax();
+	this->vTopologia.resize(this->nNumCapas);
+	for(int h=0; h<this->nNumCapas; h++)
+		this->vTopologia[h] = red.getNumNeuronas(h);
+
+	this->inicioFila.resize(this->nNumCapas);
+	this->columnas.resize(this->nNumCapas);
+	this->valores.resize(this->nNumCapas);
+	this->sesgos.resize(this->nNumCapas);
+
+	std::vector<double> pesos;
+	for(int h=1; h<this->nNumCapas; h++) {
+		int nNumEntradas = this->vTopologia[h-1];
+		int nNumColumnas = nNumEntradas + this->bSesgo;
+
+		pesos.resize((size_t) this->vTopologia[h] * nNumColumnas);
+		red.copiarPesosCapa(h, pesos.data());
+
+		this->inicioFila[h].assign(1, 0);
+		for(int j=0; j<this->vTopologia[h]; j++) {
+			const double * w = &pesos[(size_t) j * nNumColumnas];
+			for(int i=0; i<nNumEntradas; i++) {
+				if (w[i] != 0.0) {
+					this->columnas[h].push_back(i);
+					this->valores[h].push_back(w[i]);
+				}
+			}
+			this->inicioFila[h].push_back(this->valores[h].size());
+
+			if (this->bSesgo)
+				this->sesgos[h].push_back(w[nNumEntradas]);
+		}
+	}
+}
+
+// ------------------------------
+// Número de pesos de la red densa equivalente (sin contar los sesgos)
+size_t imc::RedDispersa::getNumPesos() const {
+
+	size_t nNumPesos = 0;
+	for(int h=1; h<this->nNumCapas; h++)
+		nNumPesos += (size_t) this->vTopologia[h] * this->vTopologia[h-1];
+	return nNumPesos;
+}
+
+// ------------------------------
+// Número de pesos no nulos guardados (sin contar los sesgos)
+size_t imc::RedDispersa::getNumPesosNoNulos() const {
+
+	size_t nNumPesos = 0;
+	for(int h=1; h<this->nNumCapas; h++)
+		nNumPesos += this->valores[h].size();
+	return nNumPesos;
+}
+
+// ------------------------------
+// Propagar un lote de nPatrones patrones (entradas por filas) y dejar las salidas de la red por filas en salidas
+// Mismo contrato que PerceptronMulticapa::propagarLote, pero recorriendo solo los pesos no nulos
+void imc::RedDispersa::propagarLote(const double * entradas, const int &nPatrones, double * salidas, std::vector<double> &trabajo) const {
+
+	// Se usan dos mitades del vector de trabajo de forma alterna para las salidas de cada capa
+	int nMaxNeuronas = 0;
+	for(int h=1; h<this->nNumCapas-1; h++)
+		nMaxNeuronas = std::max(nMaxNeuronas, this->vTopologia[h]);
+	trabajo.resize(2 * (size_t) nPatrones * nMaxNeuronas);
+
+	const double * entradaCapa = entradas;
+	for(int h=1; h<this->nNumCapas; h++) {
+		int nNumEntradas = this->vTopologia[h-1];
+		int nNumNeuronas = this->vTopologia[h];
+		bool bSalidaSoftmax = (h == this->nNumCapas-1 and this->bSoftmax);
+
+		// La última capa escribe directamente en salidas
+		double * salidaCapa = (h == this->nNumCapas-1) ? salidas : &trabajo[(h % 2) * (size_t) nPatrones * nMaxNeuronas];
+
+		const int * inicio = this->inicioFila[h].data();
+		const int * columna = this->columnas[h].data();
+		const double * valor = this->valores[h].data();
+
+		for(int p=0; p<nPatrones; p++) {
+			const double * x = entradaCapa + (size_t) p * nNumEntradas;
+			double * salida = salidaCapa + (size_t) p * nNumNeuronas;
+			double sumatorioSoftmax = 0.0;
+
+			for(int j=0; j<nNumNeuronas; j++) {
+				double net = this->bSesgo ? this->sesgos[h][j] : 0.0;
+				for(int k=inicio[j]; k<inicio[j+1]; k++)
+					net += valor[k] * x[columna[k]];
+
+				if (bSalidaSoftmax) {
+					salida[j] = exp(net);
+					sumatorioSoftmax += salida[j];
+				}else
+					salida[j] = 1 / (1 + exp(-net));
+			}
+
+			if (bSalidaSoftmax)
+				for(int j=0; j<nNumNeuronas; j++)
+					salida[j] /= sumatorioSoftmax;
+		}
+
+		entradaCapa = salidaCapa;
+	}
+}
+
+// ------------------------------
+// Probar la red con los patrones de una vista y devolver el CCR (sin imprimir la matriz de confusión)
+double imc::RedDispersa::testClassification(const Vista &vistaTest) const {
+
+	Datos * pDatosTest = vistaTest.pDatos;
+	int nNumSalidas = this->vTopologia[this->nNumCapas-1];
+
+	std::vector<double> salida(nNumSalidas);
+	std::vector<double> trabajo;
+
+	// Variable con el valor del ccr
+	double CCR = 0.0;
+
+	for(size_t k=0; k<vistaTest.indices.size(); k++) {
+		int i = vistaTest.indices[k];
+
+		propagarLote(pDatosTest->entradas[i].data(), 1, salida.data(), trabajo);
+
+		int indiceDeseado = pDatosTest->clases[i], indiceObtenido = 0;
+		for(int j=0; j<nNumSalidas; j++) {
+			if (salida[j] > salida[indiceObtenido])
+				indiceObtenido = j;
+		}
+
+		if (indiceDeseado == indiceObtenido)
+			CCR++;
+	}
+
+	return 100 * (CCR / vistaTest.indices.size());
+}
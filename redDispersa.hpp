@@ -0,0 +1,52 @@
+/*********************************************************************
+ * File  : redDispersa.hpp
+ * Date  : 2016
+ *********************************************************************/
+
+#ifndef _REDDISPERSA_HPP_
+#define _REDDISPERSA_HPP_
+
+#include <vector>
+#include <cstddef>
+
+#include "perceptronMulticapa.hpp"
+
+namespace imc {
+
+// Red de solo inferencia en formato disperso (CSR) obtenida de una red podada
+// Cada capa guarda únicamente los pesos no nulos de cada neurona (valor y columna); los sesgos se guardan aparte
+class RedDispersa {
+private:
+	int nNumCapas;               /* Número de capas de la red */
+	bool bSesgo;                 /* ¿Tienen sesgo las neuronas? */
+	bool bSoftmax;               /* ¿La capa de salida es softmax? */
+	std::vector<int> vTopologia; /* Número de neuronas por capa */
+
+	// Matrices CSR por capa (h>0)
+	std::vector<std::vector<int> > inicioFila;    /* Posición del primer peso no nulo de cada neurona (nNumNeuronas+1 valores) */
+	std::vector<std::vector<int> > columnas;      /* Entrada de la capa anterior a la que corresponde cada peso no nulo */
+	std::vector<std::vector<double> > valores;    /* Pesos no nulos, por filas */
+	std::vector<std::vector<double> > sesgos;     /* Sesgo de cada neurona (vacío si no hay sesgo) */
+
+public:
+
+	// CONSTRUCTOR: convertir los pesos actuales de una red (normalmente ya podada) a formato CSR
+	RedDispersa(const PerceptronMulticapa &red);
+
+	// Número de pesos de la red densa equivalente (sin contar los sesgos)
+	size_t getNumPesos() const;
+
+	// Número de pesos no nulos guardados (sin contar los sesgos)
+	size_t getNumPesosNoNulos() const;
+
+	// Propagar un lote de nPatrones patrones (entradas por filas) y dejar las salidas de la red por filas en salidas
+	// Mismo contrato que PerceptronMulticapa::propagarLote, pero recorriendo solo los pesos no nulos
+	void propagarLote(const double * entradas, const int &nPatrones, double * salidas, std::vector<double> &trabajo) const;
+
+	// Probar la red con los patrones de una vista y devolver el CCR (sin imprimir la matriz de confusión)
+	double testClassification(const Vista &vistaTest) const;
+};
+
+};
+
+#endif
@@ -0,0 +1,445 @@
+/*********************************************************************
+ * File  : servidorInferencia.cpp
+ * Date  : 2016
+ *********************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <list>
+#include <cmath>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Inclusión del archivo de cabecera de ServidorInferencia
+#include "servidorInferencia.hpp"
+
+// Tipos de respuesta que escribe cada conexión, en el mismo orden en que llegaron las líneas
+#define RESPUESTA_PREDICCION 0
+#define RESPUESTA_ERROR 1
+#define RESPUESTA_ESTADISTICAS 2
+#define RESPUESTA_FIN 3
+
+// Histograma de latencias de tamaño fijo: cada duplicación de la latencia, a partir de LATENCIA_MINIMA_HISTOGRAMA
+// microsegundos, se divide en CUBETAS_POR_DUPLICACION intervalos (error relativo de los percentiles menor del 1,1%)
+#define LATENCIA_MINIMA_HISTOGRAMA 0.1
+#define CUBETAS_POR_DUPLICACION 64
+#define NUM_CUBETAS_LATENCIA (CUBETAS_POR_DUPLICACION * 40)
+
+// Respuesta pendiente de escribir en una conexión
+struct Respuesta {
+	int tipo;
+	std::future<std::vector<double> > prediccion;
+	std::string texto;
+};
+
+// Hilo que atiende a un cliente del socket
+struct Conexion {
+	std::thread hilo;
+	bool bTerminada; /* El hilo ha terminado y solo falta recogerlo (protegido por el cerrojo de los clientes) */
+};
+
+// ------------------------------
+// Escribir una cadena completa en un descriptor, reintentando las escrituras parciales
+static bool escribirTodo(const int &descriptor, const std::string &texto) {
+
+	size_t escritos = 0;
+	while (escritos < texto.size()) {
+		ssize_t n = write(descriptor, texto.data() + escritos, texto.size() - escritos);
+		if (n == -1 and errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		escritos += n;
+	}
+	return true;
+}
+
+// ------------------------------
+// CONSTRUCTOR: servidor para una red ya entrenada o cargada
+imc::ServidorInferencia::ServidorInferencia(const PerceptronMulticapa &red, const int &tamMaxLote, const int &latenciaMaxima, const int &hilosPropagacion) {
+	this->pRed = &red;
+	this->nNumEntradas = red.getNumNeuronas(0);
+	this->nNumSalidas = red.getNumNeuronas(red.getNumCapas()-1);
+	this->nTamMaxLote = std::max(1, tamMaxLote);
+	this->nLatenciaMaxima = std::max(0, latenciaMaxima);
+	this->pRedDispersa = red.isPodada() ? new RedDispersa(red) : NULL;
+	this->pGrupo = (hilosPropagacion > 1) ? new GrupoHilos(hilosPropagacion) : NULL;
+	this->trabajosDispersa.resize(std::max(1, hilosPropagacion));
+	this->bParar = false;
+	this->nDescriptorEscucha = -1;
+	this->nNumLotes = 0;
+	this->nNumPeticiones = 0;
+	this->histogramaLatencias.assign(NUM_CUBETAS_LATENCIA, 0);
+	this->inicio = std::chrono::steady_clock::now();
+}
+
+// ------------------------------
+// DESTRUCTOR: detener los hilos de la propagación y liberar la red CSR
+imc::ServidorInferencia::~ServidorInferencia() {
+	if (this->pGrupo != NULL)
+		delete this->pGrupo;
+	if (this->pRedDispersa != NULL)
+		delete this->pRedDispersa;
+}
+
+// ------------------------------
+// Bucle del hilo que agrupa las peticiones en lotes y los propaga por la red
+void imc::ServidorInferencia::procesarLotes() {
+
+	std::vector<Peticion *> lote;
+	std::vector<double> entradas, salidas, trabajo;
+
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock(this->cerrojo);
+			this->condicion.wait(lock, [&]{ return this->bParar or !this->cola.empty(); });
+			if (this->cola.empty())
+				return;
+
+			// Se espera a completar el lote, como mucho hasta agotar la latencia de la primera petición
+			std::chrono::steady_clock::time_point limite = this->cola.front()->llegada + std::chrono::microseconds(this->nLatenciaMaxima);
+			this->condicion.wait_until(lock, limite, [&]{ return this->bParar or (int) this->cola.size() >= this->nTamMaxLote; });
+
+			lote.clear();
+			while (!this->cola.empty() and (int) lote.size() < this->nTamMaxLote) {
+				lote.push_back(this->cola.front());
+				this->cola.pop_front();
+			}
+		}
+
+		// Se agrupan los patrones del lote en una matriz contigua y se propagan todos a la vez
+		int nPatrones = lote.size();
+		entradas.resize((size_t) nPatrones * this->nNumEntradas);
+		salidas.resize((size_t) nPatrones * this->nNumSalidas);
+		for(int p=0; p<nPatrones; p++)
+			std::copy(lote[p]->entrada.begin(), lote[p]->entrada.end(), &entradas[(size_t) p * this->nNumEntradas]);
+
+		if (this->pRedDispersa != NULL and this->pGrupo != NULL) {
+			// La red CSR se reparte por patrones: cada hilo propaga un tramo contiguo del lote
+			this->pGrupo->ejecutar([&](const int &k) {
+				int nHilos = this->pGrupo->getNumHilos();
+				int pInicio = (int) ((long) nPatrones * k / nHilos);
+				int pFin = (int) ((long) nPatrones * (k+1) / nHilos);
+				if (pFin > pInicio)
+					this->pRedDispersa->propagarLote(&entradas[(size_t) pInicio * this->nNumEntradas], pFin - pInicio,
+							&salidas[(size_t) pInicio * this->nNumSalidas], this->trabajosDispersa[k]);
+			});
+		}else if (this->pRedDispersa != NULL)
+			this->pRedDispersa->propagarLote(entradas.data(), nPatrones, salidas.data(), trabajo);
+		else if (this->pGrupo != NULL)
+			this->pRed->propagarLoteParalelo(entradas.data(), nPatrones, salidas.data(), trabajo, *this->pGrupo);
+		else
+			this->pRed->propagarLote(entradas.data(), nPatrones, salidas.data(), trabajo);
+
+		std::chrono::steady_clock::time_point fin = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(this->cerrojoEstadisticas);
+			this->nNumLotes++;
+			for(int p=0; p<nPatrones; p++) {
+				double latencia = std::chrono::duration<double, std::micro>(fin - lote[p]->llegada).count();
+				int cubeta = (latencia > LATENCIA_MINIMA_HISTOGRAMA) ? (int) (log2(latencia / LATENCIA_MINIMA_HISTOGRAMA) * CUBETAS_POR_DUPLICACION) : 0;
+				this->histogramaLatencias[std::min(cubeta, NUM_CUBETAS_LATENCIA-1)]++;
+			}
+			this->nNumPeticiones += nPatrones;
+		}
+
+		for(int p=0; p<nPatrones; p++) {
+			double * fila = &salidas[(size_t) p * this->nNumSalidas];
+			lote[p]->resultado.set_value(std::vector<double>(fila, fila + this->nNumSalidas));
+			delete lote[p];
+		}
+	}
+}
+
+// ------------------------------
+// Atender una conexión: un hilo lee y encola peticiones y el hilo actual escribe las respuestas en orden
+void imc::ServidorInferencia::atenderConexion(const int &descriptorEntrada, const int &descriptorSalida) {
+
+	std::deque<Respuesta> respuestas;
+	std::mutex cerrojoRespuestas;
+	std::condition_variable condicionRespuestas;
+
+	std::thread lector([&]() {
+		FILE * f = fdopen(dup(descriptorEntrada), "r");
+		char * linea = NULL;
+		size_t tamLinea = 0;
+
+		while (f != NULL and getline(&linea, &tamLinea, f) != -1) {
+			Respuesta respuesta;
+			std::string texto(linea);
+			texto.erase(texto.find_last_not_of(" \t\r\n") + 1);
+
+			if (texto.empty())
+				continue;
+
+			if (texto == "#parar") {
+				parar();
+				break;
+			}else if (texto == "#estadisticas") {
+				respuesta.tipo = RESPUESTA_ESTADISTICAS;
+			}else{
+				// Se lee el patrón de la línea
+				Peticion * pPeticion = new Peticion;
+				const char * p = texto.c_str();
+				char * fin;
+				for(double valor = strtod(p, &fin); fin != p; valor = strtod(p, &fin)) {
+					pPeticion->entrada.push_back(valor);
+					p = fin;
+				}
+
+				if ((int) pPeticion->entrada.size() != this->nNumEntradas or *p != '\0') {
+					respuesta.tipo = RESPUESTA_ERROR;
+					respuesta.texto = "ERROR se esperaban " + std::to_string(this->nNumEntradas) + " valores numéricos";
+					delete pPeticion;
+				}else{
+					respuesta.tipo = RESPUESTA_PREDICCION;
+					respuesta.prediccion = pPeticion->resultado.get_future();
+					pPeticion->llegada = std::chrono::steady_clock::now();
+
+					std::unique_lock<std::mutex> lock(this->cerrojo);
+					if (this->bParar) {
+						// El servidor ya no procesa lotes: se responde con una predicción vacía
+						pPeticion->resultado.set_value(std::vector<double>());
+						delete pPeticion;
+					}else{
+						this->cola.push_back(pPeticion);
+						lock.unlock();
+						this->condicion.notify_all();
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(cerrojoRespuestas);
+			respuestas.push_back(std::move(respuesta));
+			condicionRespuestas.notify_one();
+		}
+
+		free(linea);
+		if (f != NULL)
+			fclose(f);
+
+		Respuesta fin;
+		fin.tipo = RESPUESTA_FIN;
+		std::lock_guard<std::mutex> lock(cerrojoRespuestas);
+		respuestas.push_back(std::move(fin));
+		condicionRespuestas.notify_one();
+	});
+
+	// Se escriben las respuestas en el orden de las peticiones
+	bool bConectado = true;
+	for(;;) {
+		Respuesta respuesta;
+		{
+			std::unique_lock<std::mutex> lock(cerrojoRespuestas);
+			condicionRespuestas.wait(lock, [&]{ return !respuestas.empty(); });
+			respuesta = std::move(respuestas.front());
+			respuestas.pop_front();
+		}
+
+		if (respuesta.tipo == RESPUESTA_FIN)
+			break;
+
+		std::ostringstream salida;
+		if (respuesta.tipo == RESPUESTA_PREDICCION) {
+			std::vector<double> prediccion = respuesta.prediccion.get();
+			if (prediccion.empty())
+				salida << "ERROR servidor detenido";
+			for(size_t j=0; j<prediccion.size(); j++)
+				salida << ((j > 0) ? " " : "") << prediccion[j];
+		}else if (respuesta.tipo == RESPUESTA_ESTADISTICAS)
+			salida << estadisticas();
+		else
+			salida << respuesta.texto;
+		salida << "\n";
+
+		// Si el cliente se ha ido, se siguen consumiendo las respuestas sin escribirlas
+		if (bConectado)
+			bConectado = escribirTodo(descriptorSalida, salida.str());
+	}
+
+	lector.join();
+}
+
+// ------------------------------
+// Detener el servidor
+void imc::ServidorInferencia::parar() {
+
+	{
+		std::lock_guard<std::mutex> lock(this->cerrojo);
+		this->bParar = true;
+		// Se desbloquea el accept() del bucle principal
+		if (this->nDescriptorEscucha != -1)
+			shutdown(this->nDescriptorEscucha, SHUT_RDWR);
+	}
+	this->condicion.notify_all();
+}
+
+// ------------------------------
+// Servir peticiones por la entrada estándar hasta fin de fichero o "#parar"
+int imc::ServidorInferencia::servirEntradaEstandar() {
+
+	this->inicio = std::chrono::steady_clock::now();
+	std::thread procesador(&ServidorInferencia::procesarLotes, this);
+
+	atenderConexion(STDIN_FILENO, STDOUT_FILENO);
+
+	parar();
+	procesador.join();
+
+	std::cerr << estadisticas() << std::endl;
+	return EXIT_SUCCESS;
+}
+
+// ------------------------------
+// Servir peticiones de varios clientes por un socket Unix hasta recibir "#parar"
+int imc::ServidorInferencia::servirSocket(const char * ruta) {
+
+	// Un cliente que se desconecta no debe terminar el servidor
+	signal(SIGPIPE, SIG_IGN);
+
+	int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (descriptor == -1) {
+		std::cerr << "\n # No se pudo crear el socket: " << strerror(errno) << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	struct sockaddr_un direccion;
+	memset(&direccion, 0, sizeof(direccion));
+	direccion.sun_family = AF_UNIX;
+	if (strlen(ruta) >= sizeof(direccion.sun_path)) {
+		std::cerr << "\n # La ruta del socket es demasiado larga: " << ruta << std::endl;
+		close(descriptor);
+		return EXIT_FAILURE;
+	}
+	strcpy(direccion.sun_path, ruta);
+	unlink(ruta);
+
+	if (bind(descriptor, (struct sockaddr *) &direccion, sizeof(direccion)) == -1 or listen(descriptor, SOMAXCONN) == -1) {
+		std::cerr << "\n # No se pudo escuchar en " << ruta << ": " << strerror(errno) << std::endl;
+		close(descriptor);
+		return EXIT_FAILURE;
+	}
+
+	this->nDescriptorEscucha = descriptor;
+	this->inicio = std::chrono::steady_clock::now();
+	std::thread procesador(&ServidorInferencia::procesarLotes, this);
+
+	std::cout << " # Servidor escuchando en " << ruta << std::endl;
+
+	// Un hilo por cliente; al parar se cierran las lecturas de los clientes que sigan conectados
+	// Cada hilo marca su conexión como terminada y el bucle de aceptación recoge (join) las terminadas,
+	// así que solo quedan hilos de los clientes conectados
+	std::list<Conexion> conexiones;
+	std::set<int> clientes;
+	std::mutex cerrojoClientes;
+
+	for(;;) {
+		int cliente = accept(descriptor, NULL, NULL);
+		if (cliente == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		std::list<Conexion> terminadas;
+		{
+			std::lock_guard<std::mutex> lock(cerrojoClientes);
+			for(std::list<Conexion>::iterator it=conexiones.begin(); it!=conexiones.end(); ) {
+				std::list<Conexion>::iterator actual = it++;
+				if (actual->bTerminada)
+					terminadas.splice(terminadas.end(), conexiones, actual);
+			}
+
+			clientes.insert(cliente);
+			conexiones.emplace_back();
+			Conexion &conexion = conexiones.back();
+			conexion.bTerminada = false;
+			conexion.hilo = std::thread([this, cliente, &conexion, &clientes, &cerrojoClientes]() {
+				atenderConexion(cliente, cliente);
+				std::lock_guard<std::mutex> lock(cerrojoClientes);
+				clientes.erase(cliente);
+				close(cliente);
+				conexion.bTerminada = true;
+			});
+		}
+		for(std::list<Conexion>::iterator it=terminadas.begin(); it!=terminadas.end(); ++it)
+			it->hilo.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(cerrojoClientes);
+		for(std::set<int>::iterator it=clientes.begin(); it!=clientes.end(); ++it)
+			shutdown(*it, SHUT_RD);
+	}
+	for(std::list<Conexion>::iterator it=conexiones.begin(); it!=conexiones.end(); ++it)
+		it->hilo.join();
+
+	parar();
+	procesador.join();
+
+	{
+		std::lock_guard<std::mutex> lock(this->cerrojo);
+		this->nDescriptorEscucha = -1;
+	}
+	close(descriptor);
+	unlink(ruta);
+
+	std::cout << estadisticas() << std::endl;
+	return EXIT_SUCCESS;
+}
+
+// ------------------------------
+// Latencia aproximada (microsegundos) por debajo de la que queda el porcentaje indicado de peticiones
+// Se devuelve el centro geométrico de la cubeta del histograma en la que cae el percentil
+double imc::ServidorInferencia::percentilLatencia(const double &porcentaje) const {
+
+	if (this->nNumPeticiones == 0)
+		return 0.0;
+
+	long nPosicion = (long) ((this->nNumPeticiones - 1) * porcentaje / 100);
+	long nAcumulado = 0;
+	int cubeta = 0;
+	for(; cubeta<NUM_CUBETAS_LATENCIA-1; cubeta++) {
+		nAcumulado += this->histogramaLatencias[cubeta];
+		if (nAcumulado > nPosicion)
+			break;
+	}
+	return LATENCIA_MINIMA_HISTOGRAMA * exp2((cubeta + 0.5) / CUBETAS_POR_DUPLICACION);
+}
+
+// ------------------------------
+// Resumen de los contadores: peticiones, lotes, rendimiento y percentiles 50 y 99 de latencia
+// Los percentiles se obtienen del histograma, así que el coste no depende del nº de peticiones atendidas
+std::string imc::ServidorInferencia::estadisticas() {
+
+	long nNumPeticiones, nNumLotes;
+	double p50, p99;
+	{
+		std::lock_guard<std::mutex> lock(this->cerrojoEstadisticas);
+		nNumPeticiones = this->nNumPeticiones;
+		nNumLotes = this->nNumLotes;
+		p50 = percentilLatencia(50);
+		p99 = percentilLatencia(99);
+	}
+
+	double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->inicio).count();
+
+	std::ostringstream texto;
+	texto << "peticiones=" << nNumPeticiones
+	      << " lotes=" << nNumLotes
+	      << " tamLoteMedio=" << ((nNumLotes > 0) ? (double) nNumPeticiones / nNumLotes : 0.0)
+	      << " peticiones/s=" << ((segundos > 0) ? nNumPeticiones / segundos : 0.0)
+	      << " p50_us=" << p50
+	      << " p99_us=" << p99;
+	return texto.str();
+}
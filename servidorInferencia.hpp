@@ -0,0 +1,96 @@
+/*********************************************************************
+ * File  : servidorInferencia.hpp
+ * Date  : 2016
+ *********************************************************************/
+
+#ifndef _SERVIDORINFERENCIA_HPP_
+#define _SERVIDORINFERENCIA_HPP_
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "perceptronMulticapa.hpp"
+#include "grupoHilos.hpp"
+#include "redDispersa.hpp"
+
+namespace imc {
+
+// Petición de predicción pendiente de agrupar en un lote
+struct Peticion {
+	std::vector<double> entrada;                        /* Patrón a clasificar */
+	std::chrono::steady_clock::time_point llegada;      /* Momento en que se recibió */
+	std::promise<std::vector<double> > resultado;       /* Salidas de la red (probabilidades solo con softmax) */
+};
+
+// Servidor de inferencia de larga duración
+// Recibe patrones (una línea de números por patrón) por la entrada estándar o por un socket Unix,
+// agrupa las peticiones concurrentes en lotes dentro de un presupuesto de latencia y
+// devuelve una línea con la salida de la red por cada patrón
+// Las líneas "#estadisticas" y "#parar" consultan los contadores y detienen el servidor
+class ServidorInferencia {
+private:
+	const PerceptronMulticapa * pRed; /* Red ya entrenada que se sirve */
+	int nNumEntradas;    /* Nº de entradas de la red */
+	int nNumSalidas;     /* Nº de salidas de la red */
+	int nTamMaxLote;     /* Nº máximo de patrones por lote */
+	int nLatenciaMaxima; /* Tiempo máximo (microsegundos) que espera la primera petición de un lote */
+	RedDispersa * pRedDispersa; /* Red en formato CSR si la red servida está podada (NULL => se propaga la red densa) */
+	GrupoHilos * pGrupo; /* Hilos entre los que se reparte la propagación de cada lote (NULL => un único hilo) */
+	std::vector<std::vector<double> > trabajosDispersa; /* Vector de trabajo de cada hilo para la red CSR */
+
+	// Cola de peticiones pendientes
+	std::deque<Peticion *> cola;
+	std::mutex cerrojo;
+	std::condition_variable condicion;
+	bool bParar;
+	int nDescriptorEscucha; /* Socket de escucha (-1 si se usa la entrada estándar) */
+
+	// Contadores de rendimiento
+	std::mutex cerrojoEstadisticas;
+	std::vector<long> histogramaLatencias; /* Nº de peticiones atendidas en cada intervalo (logarítmico) de latencia */
+	long nNumPeticiones;           /* Nº de peticiones atendidas */
+	long nNumLotes;                /* Nº de lotes procesados */
+	std::chrono::steady_clock::time_point inicio;
+
+	// Bucle del hilo que agrupa las peticiones en lotes y los propaga por la red
+	void procesarLotes();
+
+	// Atender una conexión: un hilo lee y encola peticiones y el hilo actual escribe las respuestas en orden
+	void atenderConexion(const int &descriptorEntrada, const int &descriptorSalida);
+
+	// Detener el servidor
+	void parar();
+
+	// Latencia aproximada (microsegundos) por debajo de la que queda el porcentaje indicado de peticiones
+	// Debe llamarse con cerrojoEstadisticas tomado
+	double percentilLatencia(const double &porcentaje) const;
+
+public:
+
+	// CONSTRUCTOR: servidor para una red ya entrenada o cargada
+	// Si la red está podada, se sirve su versión en formato CSR
+	// Con hilosPropagacion > 1, cada lote se reparte entre un grupo persistente de hilos: la red densa con
+	// propagarLoteParalelo y la red CSR por patrones
+	ServidorInferencia(const PerceptronMulticapa &red, const int &tamMaxLote, const int &latenciaMaxima, const int &hilosPropagacion);
+
+	// DESTRUCTOR: detener los hilos de la propagación y liberar la red CSR
+	~ServidorInferencia();
+
+	// Servir peticiones por la entrada estándar hasta fin de fichero o "#parar"
+	int servirEntradaEstandar();
+
+	// Servir peticiones de varios clientes por un socket Unix hasta recibir "#parar"
+	int servirSocket(const char * ruta);
+
+	// Resumen de los contadores: peticiones, lotes, rendimiento y percentiles 50 y 99 de latencia
+	std::string estadisticas();
+};
+
+};
+
+#endif